@@ -0,0 +1,78 @@
+#ifndef ADDITIVEOSC_HPP
+#define ADDITIVEOSC_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Single-cycle tables for a fixed set of harmonic weights. Table k holds the
+// sum of the first k harmonics, so an oscillator can drop the harmonics above
+// Nyquist by picking a smaller table instead of aliasing.
+class AdditiveTable {
+public:
+    static const int sizeBits = 11;
+    static const int size = 1 << sizeBits;
+
+    explicit AdditiveTable(const std::vector<float> &weights)
+        : tables(weights.size()) {
+        const double twoPi = 6.283185307179586;
+        std::vector<float> sum(size + 1, 0.f);
+        for(size_t h = 0; h < weights.size(); h++){
+            for(int i = 0; i <= size; i++){
+                sum[i] += weights[h] * (float)std::sin(twoPi * (h + 1) * i / size);
+            }
+            tables[h] = sum;   // last entry repeats the first for interpolation
+        }
+    }
+
+    int harmonics() const {
+        return (int)tables.size();
+    }
+    // table with the first `count` harmonics, 1 <= count <= harmonics()
+    const float * table(int count) const {
+        return tables[count - 1].data();
+    }
+
+private:
+    std::vector<std::vector<float>> tables;
+};
+
+// Phase-accumulator oscillator over an AdditiveTable. freq() selects the
+// table with every harmonic that fits below Nyquist; above that it is silent.
+class WavetableOsc {
+public:
+    void source(const AdditiveTable *t){
+        tables = t;
+    }
+    void freq(float f, float sampleRate){
+        int count = std::min(tables->harmonics(), (int)(0.5f * sampleRate / f));
+        current = count > 0 ? tables->table(count) : nullptr;
+        increment = (uint32_t)(f / sampleRate * 4294967296.0);
+    }
+    void reset(){
+        phase = 0;
+    }
+    float operator()(){
+        if(!current){
+            return 0;
+        }
+        uint32_t i = phase >> fracBits;
+        float frac = (phase & fracMask) * (1.f / (fracMask + 1.f));
+        float a = current[i];
+        float v = a + frac * (current[i + 1] - a);
+        phase += increment;
+        return v;
+    }
+
+private:
+    static const int fracBits = 32 - AdditiveTable::sizeBits;
+    static const uint32_t fracMask = (1u << fracBits) - 1;
+
+    const AdditiveTable *tables = nullptr;
+    const float *current = nullptr;
+    uint32_t phase = 0;       // wraps at 2^32 = one cycle
+    uint32_t increment = 0;
+};
+
+#endif
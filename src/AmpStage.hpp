@@ -0,0 +1,105 @@
+#ifndef AMPSTAGE_HPP
+#define AMPSTAGE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+#include "DspKernels.hpp"
+#include "Oversampler.hpp"
+
+// tanh soft clipping read from a table with linear interpolation, through
+// the waveshape kernel. Past the table's range the curve is flat at +/-1,
+// within 1e-4 of tanh.
+class Waveshaper {
+public:
+    static const int size = 2048;
+
+    Waveshaper() : table(size + 2) {
+        for(int i = 0; i <= size + 1; i++){
+            table[i] = (float)std::tanh(range * (2.0 * i / size - 1));
+        }
+    }
+
+    // buf[i] = shape(buf[i] * (gain + step * i)) * level
+    void process(float *buf, int n, float gain, float step, float level) const {
+        dspKernels().waveshape(buf, n, table.data(), size, size / (2 * range), size / 2,
+                               gain, step, level);
+    }
+
+    static const Waveshaper &shared(){
+        static const Waveshaper shaper;
+        return shaper;
+    }
+
+private:
+    static constexpr float range = 5.f;   // table covers [-range, range]
+    std::vector<float> table;
+};
+
+// Guitar amp drive for one track: gain into a soft clipper, then an output
+// level. Clipping makes harmonics well past Nyquist, so the shaper runs
+// 2x, 4x or 8x oversampled; they are filtered out before the signal comes
+// back down and do not alias. It runs on the summed track bus rather than
+// in every voice, so its cost does not grow with polyphony.
+//
+// drive() and level() may be called from any thread. A new drive ramps in
+// over the next block.
+class AmpStage {
+public:
+    // oversampling 0 bypasses the stage. Call before audio starts.
+    void prepare(int oversampling, int channels, int maxFrames){
+        enabledFactor = oversampling;
+        Waveshaper::shared();   // build the table off the audio thread
+        resamplers.assign(oversampling > 0 ? channels : 0, Oversampler());
+        for(auto &r : resamplers){
+            r.prepare(oversampling, maxFrames);
+        }
+    }
+
+    bool enabled() const {
+        return !resamplers.empty();
+    }
+    int oversampling() const {
+        return enabledFactor;
+    }
+    int maxFrames() const {
+        return resamplers.empty() ? 0 : resamplers[0].maxFrames();
+    }
+
+    void drive(float db){
+        targetDrive.store(std::pow(10.f, db / 20), std::memory_order_relaxed);
+    }
+    void level(float db){
+        targetLevel.store(std::pow(10.f, db / 20), std::memory_order_relaxed);
+    }
+
+    // processes each channel in place
+    void process(float *const *channels, int numChannels, int frames){
+        if(!enabled()){
+            return;
+        }
+        float drive = targetDrive.load(std::memory_order_relaxed);
+        float out = targetLevel.load(std::memory_order_relaxed);
+        const Waveshaper &shaper = Waveshaper::shared();
+        int n = std::min(numChannels, (int)resamplers.size());
+        for(int c = 0; c < n; c++){
+            Oversampler &r = resamplers[c];
+            int hiFrames = frames * r.factor();
+            float *hi = r.up(channels[c], frames);
+            shaper.process(hi, hiFrames, gain, (drive - gain) / hiFrames, out);
+            r.down(channels[c], frames);
+        }
+        gain = drive;
+    }
+
+private:
+    std::vector<Oversampler> resamplers;   // one per channel
+    int enabledFactor = 0;
+    std::atomic<float> targetDrive{1.f};
+    std::atomic<float> targetLevel{1.f};
+    float gain = 1.f;   // drive applied at the end of the last block
+};
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef CONVOLVER_HPP
+#define CONVOLVER_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+#include "DspKernels.hpp"
+#include "FFT.hpp"
+
+// An impulse response cut into equal partitions of `partition` samples,
+// each stored as the spectrum of the partition zero-padded to twice its
+// length. Built once off the audio thread; any number of Convolvers can
+// share it.
+class PartitionedIR {
+public:
+    PartitionedIR(const std::vector<float> &ir, int partition)
+        : partitionSize(partition),
+          numPartitions(std::max<int>(1, ((int)ir.size() + partition - 1) / partition)),
+          numBins(partition + 1),
+          re((size_t)numPartitions * numBins),
+          im((size_t)numPartitions * numBins) {
+        RealFFT fft(2 * partition);
+        std::vector<float> padded(2 * partition);
+        for(int p = 0; p < numPartitions; p++){
+            std::fill(padded.begin(), padded.end(), 0.f);
+            size_t begin = (size_t)p * partition;
+            size_t end = std::min(ir.size(), begin + partition);
+            if(begin < end){
+                std::copy(ir.begin() + begin, ir.begin() + end, padded.begin());
+            }
+            fft.forward(padded.data(), &re[(size_t)p * numBins], &im[(size_t)p * numBins]);
+        }
+    }
+
+    int partition() const {
+        return partitionSize;
+    }
+    int partitions() const {
+        return numPartitions;
+    }
+    int bins() const {
+        return numBins;
+    }
+    const float *partitionRe(int p) const {
+        return &re[(size_t)p * numBins];
+    }
+    const float *partitionIm(int p) const {
+        return &im[(size_t)p * numBins];
+    }
+
+private:
+    int partitionSize;
+    int numPartitions;
+    int numBins;
+    std::vector<float> re, im;
+};
+
+// Uniformly partitioned overlap-save convolution. Each partition of input
+// is transformed once and kept in a frequency-domain delay line. An output
+// partition is the inverse transform of the delay line multiplied by the IR
+// partitions and summed. Cost per sample is two FFTs of 2B points
+// (O(log B)) plus one complex multiply-add per IR partition.
+//
+// The latency is fixed by prepare() for the whole stream. With ZeroLatency
+// every call must hand in whole partitions, which are convolved in the same
+// call. With OnePartition a call may be any length; samples go through a
+// FIFO and all come out one partition late. Nothing allocates after
+// prepare().
+class Convolver {
+public:
+    enum Latency { ZeroLatency, OnePartition };
+
+    // ZeroLatency when every block of `blockSize` frames is whole
+    // partitions, else OnePartition
+    static Latency latencyFor(const PartitionedIR &ir, int blockSize){
+        return blockSize % ir.partition() == 0 ? ZeroLatency : OnePartition;
+    }
+
+    void prepare(std::shared_ptr<const PartitionedIR> impulse, Latency latency){
+        ir = std::move(impulse);
+        mode = latency;
+        int b = ir->partition();
+        fft.reset(new RealFFT(2 * b));
+        time.assign(2 * b, 0.f);
+        scratch.assign(2 * b, 0.f);
+        spectrumRe.assign((size_t)ir->partitions() * ir->bins(), 0.f);
+        spectrumIm.assign((size_t)ir->partitions() * ir->bins(), 0.f);
+        accRe.assign(ir->bins(), 0.f);
+        accIm.assign(ir->bins(), 0.f);
+        inFifo.assign(b, 0.f);
+        outFifo.assign(b, 0.f);
+        reset();
+    }
+
+    void reset(){
+        std::fill(time.begin(), time.end(), 0.f);
+        std::fill(spectrumRe.begin(), spectrumRe.end(), 0.f);
+        std::fill(spectrumIm.begin(), spectrumIm.end(), 0.f);
+        std::fill(outFifo.begin(), outFifo.end(), 0.f);
+        head = 0;
+        fill = 0;
+    }
+
+    Latency latency() const {
+        return mode;
+    }
+
+    // Convolves buf with the IR in place. With ZeroLatency, frames must be
+    // a multiple of the partition.
+    void process(float *buf, int frames){
+        if(!ir){
+            return;
+        }
+        const int b = ir->partition();
+        if(mode == ZeroLatency){
+            assert(frames % b == 0);
+            for(int i = 0; i + b <= frames; i += b){
+                convolve(buf + i, buf + i);
+            }
+            return;
+        }
+        int i = 0;
+        while(i < frames){
+            int n = std::min(frames - i, b - fill);
+            std::copy(buf + i, buf + i + n, inFifo.begin() + fill);
+            std::copy(outFifo.begin() + fill, outFifo.begin() + fill + n, buf + i);
+            fill += n;
+            i += n;
+            if(fill == b){
+                convolve(inFifo.data(), outFifo.data());
+                fill = 0;
+            }
+        }
+    }
+
+private:
+    // one partition; in and out may alias
+    void convolve(const float *in, float *out){
+        const int b = ir->partition();
+        const int bins = ir->bins();
+        const int parts = ir->partitions();
+
+        // overlap-save: transform [previous partition, this partition]
+        std::copy(time.begin() + b, time.end(), time.begin());
+        std::copy(in, in + b, time.begin() + b);
+        head = (head + parts - 1) % parts;
+        float *xr = &spectrumRe[(size_t)head * bins];
+        float *xi = &spectrumIm[(size_t)head * bins];
+        fft->forward(time.data(), xr, xi);
+
+        // input spectrum j partitions ago times IR partition j
+        std::fill(accRe.begin(), accRe.end(), 0.f);
+        std::fill(accIm.begin(), accIm.end(), 0.f);
+        float *ar = accRe.data();
+        float *ai = accIm.data();
+        const DspKernels &kernels = dspKernels();
+        for(int j = 0; j < parts; j++){
+            int slot = (head + j) % parts;
+            kernels.complexMultiplyAdd(ar, ai,
+                                       &spectrumRe[(size_t)slot * bins],
+                                       &spectrumIm[(size_t)slot * bins],
+                                       ir->partitionRe(j), ir->partitionIm(j), bins);
+        }
+
+        // the first half is circular wrap-around; keep the second
+        fft->inverse(ar, ai, scratch.data());
+        std::copy(scratch.begin() + b, scratch.end(), out);
+    }
+
+    std::shared_ptr<const PartitionedIR> ir;
+    std::unique_ptr<RealFFT> fft;
+    std::vector<float> time;                     // last two input partitions
+    std::vector<float> spectrumRe, spectrumIm;   // frequency-domain delay line
+    std::vector<float> accRe, accIm;
+    std::vector<float> inFifo, outFifo;
+    std::vector<float> scratch;                  // inverse transform
+    Latency mode = ZeroLatency;
+    int head = 0;   // delay-line slot of the newest input spectrum
+    int fill = 0;   // samples in inFifo
+};
+
+#endif
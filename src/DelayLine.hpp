@@ -0,0 +1,57 @@
+#ifndef DELAYLINE_HPP
+#define DELAYLINE_HPP
+
+#include <algorithm>
+#include <memory>
+
+// Fixed-capacity delay line. Capacity must be a power of two so positions
+// wrap with a mask instead of a modulo. The write position only ever grows
+// (unsigned overflow is well defined), read(d) returns the sample written
+// d samples ago.
+template <typename T, int Capacity>
+class DelayLine {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "DelayLine capacity must be a power of two");
+public:
+    static const int capacity = Capacity;
+    static const unsigned mask = Capacity - 1;
+
+    DelayLine() : buffer(new T[Capacity]()), writePos(0) {}
+
+    DelayLine(DelayLine &&) = default;
+    DelayLine & operator=(DelayLine &&) = default;
+    DelayLine(const DelayLine &) = delete;
+    DelayLine & operator=(const DelayLine &) = delete;
+
+    void clear(){
+        std::fill(buffer.get(), buffer.get() + Capacity, T(0));
+        writePos = 0;
+    }
+    void write(T x){
+        buffer[writePos & mask] = x;
+        writePos++;
+    }
+    T read(int delay) const {
+        return buffer[(writePos - delay) & mask];
+    }
+
+    // raw access for block kernels, which index with (pos & mask) and call
+    // advance() once with the number of samples they wrote
+    T * data(){
+        return buffer.get();
+    }
+    const T * data() const {
+        return buffer.get();
+    }
+    unsigned position() const {
+        return writePos;
+    }
+    void advance(int n){
+        writePos += n;
+    }
+private:
+    std::unique_ptr<T[]> buffer;
+    unsigned writePos;
+};
+
+#endif
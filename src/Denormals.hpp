@@ -0,0 +1,42 @@
+#ifndef DENORMALS_HPP
+#define DENORMALS_HPP
+
+#include <cstdint>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define DENORMALS_SSE 1
+#endif
+
+// Denormal (subnormal) floats are handled in microcode on x86, so a
+// feedback loop that decays into them can run 10-100x slower. These set
+// the calling thread's float unit to flush them to zero: FTZ and DAZ
+// on SSE, FZ on AArch64. The mode is per thread. Call it from the thread
+// that renders, not from the one that opens the device.
+inline void flushDenormals(bool on){
+#if defined(DENORMALS_SSE)
+    const unsigned ftzDaz = 0x8040;   // MXCSR bit 15 (FTZ) and bit 6 (DAZ)
+    unsigned csr = _mm_getcsr();
+    _mm_setcsr(on ? (csr | ftzDaz) : (csr & ~ftzDaz));
+#elif defined(__aarch64__)
+    uint64_t fpcr;
+    __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+    const uint64_t fz = (uint64_t)1 << 24;
+    fpcr = on ? (fpcr | fz) : (fpcr & ~fz);
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr));
+#else
+    (void)on;
+#endif
+}
+
+// For the top of an audio callback: sets the mode the first time the
+// calling thread gets here and is a flag test afterwards.
+inline void flushDenormalsOnThisThread(){
+    static thread_local bool done = false;
+    if(!done){
+        flushDenormals(true);
+        done = true;
+    }
+}
+
+#endif
@@ -0,0 +1,44 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "DspKernels.hpp"
+
+extern const DspKernels dspKernelsGeneric;
+#if GUITAR_DSP_X86_KERNELS
+extern const DspKernels dspKernelsAvx2;
+extern const DspKernels dspKernelsAvx512;
+#endif
+
+// Best variant this CPU can run, or the one named by GUITAR_DSP_ISA if the
+// CPU supports it (for comparing variants). Only the GCC/Clang builtins
+// are used for detection; other compilers get the generic kernels.
+static const DspKernels &detect(){
+    const char *forced = std::getenv("GUITAR_DSP_ISA");
+    const DspKernels *best = &dspKernelsGeneric;
+    if(forced && std::strcmp(forced, best->isa) == 0){
+        return *best;
+    }
+#if GUITAR_DSP_X86_KERNELS && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    const DspKernels *candidates[] = {&dspKernelsAvx2, &dspKernelsAvx512};
+    const bool supported[] = {
+        (bool)__builtin_cpu_supports("avx2"),
+        (bool)__builtin_cpu_supports("avx512f"),
+    };
+    for(int i = 0; i < 2; i++){
+        if(!supported[i]){
+            continue;
+        }
+        if(forced && std::strcmp(forced, candidates[i]->isa) == 0){
+            return *candidates[i];
+        }
+        best = candidates[i];
+    }
+#endif
+    return *best;
+}
+
+const DspKernels &dspKernels(){
+    static const DspKernels &kernels = detect();
+    return kernels;
+}
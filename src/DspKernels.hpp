@@ -0,0 +1,38 @@
+#ifndef DSPKERNELS_HPP
+#define DSPKERNELS_HPP
+
+// The guitar DSP loops that gain from wider vectors, compiled once per
+// instruction set in the guitar_dsp library (generic, AVX2 and AVX-512F)
+// and picked for the running CPU the first time dspKernels() is called.
+// Everything else, the rest of the voice and FFT code included, is built
+// once with the app's flags. Every variant performs the same float
+// operations in the same order, so their results are bit-identical.
+struct DspKernels {
+    const char *isa;
+
+    // see karplusStrongBlock() in KarplusStrong.hpp
+    void (*karplusStrongBlock)(float *line, unsigned mask, unsigned writePos,
+                               int length, float gain, float *out, int frames);
+
+    // acc += x * h over n complex values stored split
+    void (*complexMultiplyAdd)(float *accRe, float *accIm,
+                               const float *xRe, const float *xIm,
+                               const float *hRe, const float *hIm, int n);
+
+    // out[i] += in[i] * (gain + step * i), a gain-matrix entry with an
+    // optional ramp
+    void (*mixGain)(float *out, const float *in, float gain, float step, int n);
+
+    // out[i] = sum over k of taps[k] * in[i + k], for n outputs; in holds
+    // n + numTaps - 1 samples
+    void (*firBlock)(float *out, const float *in, const float *taps, int numTaps, int n);
+
+    // buf[i] = lookup(buf[i] * (gain + step * i)) * level, where lookup
+    // interpolates table[0..size] linearly at x * scale + offset, clamped
+    void (*waveshape)(float *buf, int n, const float *table, int size,
+                      float scale, float offset, float gain, float step, float level);
+};
+
+const DspKernels &dspKernels();
+
+#endif
@@ -0,0 +1,107 @@
+// Kernel bodies for one instruction set. Each DspKernels*.cpp defines
+// DSP_KERNELS_ISA and DSP_KERNELS_TABLE, then includes this file, and is
+// compiled with that ISA's flags.
+//
+// Everything here has internal linkage and calls no inline function from a
+// header. The linker keeps one copy of an inline function across all
+// translation units, and could pick the AVX-512 copy for code that runs on
+// every CPU.
+
+#include "DspKernels.hpp"
+#include "KarplusStrong.hpp"
+
+namespace {
+
+inline int minInt(int a, int b){
+    return a < b ? a : b;
+}
+
+void karplusStrongBlockKernel(float * line, unsigned mask, unsigned writePos,
+                              int length, float gain, float * out, int frames){
+    const int capacity = (int)mask + 1;
+    const float bias = karplusStrongBias;
+    while(frames > 0){
+        unsigned r = (writePos - length) & mask;
+        unsigned wi = writePos & mask;
+        int run = minInt(minInt(frames, length - 1),
+                         minInt((int)(mask - r), capacity - (int)wi));
+        if(run <= 0){
+            float a = line[r];
+            line[wi] = (a + line[(r + 1) & mask]) * gain + bias;
+            out[0] += a;
+            run = 1;
+        } else {
+            const float * rd = line + r;
+            float * wr = line + wi;
+            for(int i = 0; i < run; i++){
+                float a = rd[i];
+                out[i] += a;
+                wr[i] = (a + rd[i + 1]) * gain + bias;
+            }
+        }
+        out += run;
+        frames -= run;
+        writePos += run;
+    }
+}
+
+void complexMultiplyAddKernel(float * __restrict accRe, float * __restrict accIm,
+                              const float * __restrict xRe, const float * __restrict xIm,
+                              const float * __restrict hRe, const float * __restrict hIm,
+                              int n){
+    for(int k = 0; k < n; k++){
+        accRe[k] += xRe[k] * hRe[k] - xIm[k] * hIm[k];
+        accIm[k] += xRe[k] * hIm[k] + xIm[k] * hRe[k];
+    }
+}
+
+void mixGainKernel(float * __restrict out, const float * __restrict in,
+                   float gain, float step, int n){
+    for(int i = 0; i < n; i++){
+        out[i] += in[i] * (gain + step * (float)i);
+    }
+}
+
+// one tap at a time across all outputs, so the loop vectorizes over
+// outputs and each sum is added up in tap order on every ISA
+void firBlockKernel(float * __restrict out, const float * __restrict in,
+                    const float * __restrict taps, int numTaps, int n){
+    for(int i = 0; i < n; i++){
+        out[i] = 0.f;
+    }
+    for(int k = 0; k < numTaps; k++){
+        const float t = taps[k];
+        const float * x = in + k;
+        for(int i = 0; i < n; i++){
+            out[i] += t * x[i];
+        }
+    }
+}
+
+// branch-free, so the table reads become gathers where the ISA has them
+void waveshapeKernel(float * __restrict buf, int n, const float * __restrict table,
+                     int size, float scale, float offset, float gain, float step,
+                     float level){
+    const float top = (float)size;
+    for(int i = 0; i < n; i++){
+        float x = buf[i] * (gain + step * (float)i) * scale + offset;
+        x = x > 0.f ? x : 0.f;
+        x = x < top ? x : top;
+        int k = (int)x;
+        float frac = x - (float)k;
+        float a = table[k];
+        float b = table[k + 1];
+        buf[i] = (a + (b - a) * frac) * level;
+    }
+}
+
+}
+
+extern const DspKernels DSP_KERNELS_TABLE = {
+    DSP_KERNELS_ISA,
+    &karplusStrongBlockKernel,
+    &complexMultiplyAddKernel,
+    &mixGainKernel,
+    &firBlockKernel,
+    &waveshapeKernel,
+};
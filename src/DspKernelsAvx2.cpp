@@ -0,0 +1,3 @@
+#define DSP_KERNELS_ISA "avx2"
+#define DSP_KERNELS_TABLE dspKernelsAvx2
+#include "DspKernels.inl"
@@ -0,0 +1,3 @@
+#define DSP_KERNELS_ISA "avx512"
+#define DSP_KERNELS_TABLE dspKernelsAvx512
+#include "DspKernels.inl"
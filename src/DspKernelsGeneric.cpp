@@ -0,0 +1,3 @@
+#define DSP_KERNELS_ISA "generic"
+#define DSP_KERNELS_TABLE dspKernelsGeneric
+#include "DspKernels.inl"
@@ -0,0 +1,141 @@
+#ifndef EVENTLOG_HPP
+#define EVENTLOG_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Build with -DGUITAR_EVENT_LOG=0 to compile every LOG_VOICE_EVENT away.
+#ifndef GUITAR_EVENT_LOG
+#define GUITAR_EVENT_LOG 1
+#endif
+
+// Bounded single-producer single-consumer queue. push() and pop() never
+// block or allocate; push() fails when the ring is full.
+template <typename T, int Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "SpscRing capacity must be a power of two");
+public:
+    bool push(const T &item){
+        uint32_t head = writeCount.load(std::memory_order_relaxed);
+        uint32_t tail = readCount.load(std::memory_order_acquire);
+        if(head - tail == (uint32_t)Capacity){
+            return false;
+        }
+        items[head & (Capacity - 1)] = item;
+        writeCount.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    bool pop(T &item){
+        uint32_t tail = readCount.load(std::memory_order_relaxed);
+        uint32_t head = writeCount.load(std::memory_order_acquire);
+        if(head == tail){
+            return false;
+        }
+        item = items[tail & (Capacity - 1)];
+        readCount.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+private:
+    T items[Capacity];
+    alignas(64) std::atomic<uint32_t> writeCount{0};
+    alignas(64) std::atomic<uint32_t> readCount{0};
+};
+
+struct VoiceEvent {
+    enum Type : uint8_t { NoteOn, NoteOff };
+
+    uint64_t timeNs;   // since the log was created
+    int voiceId;
+    float frequency;
+    Type type;
+};
+
+// Structured log the audio thread writes voice events into instead of
+// formatting text itself. A UI or background thread calls drain() to print
+// them. Records that do not fit are dropped and counted.
+//
+// Rings are keyed by role rather than by thread, so each keeps a single
+// producer while threads come and go. Role 0 is the audio thread, or the
+// thread rendering in its place (the latency probe, an offline render), and
+// a new audio thread after a device reopen takes it over. Render worker n
+// takes role n. Roles from maxProducers up are dropped.
+class EventLog {
+public:
+    static const int maxProducers = 16;
+
+    // Sets the role of the calling thread for its later posts.
+    static void threadRole(int role){
+        currentRole() = role;
+    }
+
+    EventLog() : start(std::chrono::steady_clock::now()) {}
+
+    void post(VoiceEvent::Type type, int voiceId, float frequency){
+        VoiceEvent e;
+        e.timeNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        e.voiceId = voiceId;
+        e.frequency = frequency;
+        e.type = type;
+        Ring *ring = producerRing();
+        if(!ring || !ring->push(e)){
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Formats everything queued so far. Consumer side only.
+    void drain(std::ostream &out){
+        VoiceEvent e;
+        for(int p = 0; p < maxProducers; p++){
+            while(rings[p].pop(e)){
+                out << e.timeNs * 1e-9 << "s voice " << e.voiceId;
+                if(e.type == VoiceEvent::NoteOn){
+                    out << " new note created with f=" << e.frequency << "\n";
+                } else {
+                    out << " note released\n";
+                }
+            }
+        }
+        uint32_t lost = dropped.exchange(0, std::memory_order_relaxed);
+        if(lost > 0){
+            out << lost << " voice events dropped\n";
+        }
+        out.flush();
+    }
+
+private:
+    typedef SpscRing<VoiceEvent, 1024> Ring;
+
+    // a plain int, so no thread-exit destructor is registered (which would
+    // allocate) on the audio thread
+    static int &currentRole(){
+        static thread_local int role = 0;
+        return role;
+    }
+    Ring *producerRing(){
+        int role = currentRole();
+        return role >= 0 && role < maxProducers ? &rings[role] : nullptr;
+    }
+
+    std::chrono::steady_clock::time_point start;
+    Ring rings[maxProducers];
+    std::atomic<uint32_t> dropped{0};
+};
+
+inline EventLog &eventLog(){
+    static EventLog log;
+    return log;
+}
+
+#if GUITAR_EVENT_LOG
+#define LOG_VOICE_EVENT(type, voiceId, frequency) \
+    eventLog().post(VoiceEvent::type, voiceId, frequency)
+#else
+#define LOG_VOICE_EVENT(type, voiceId, frequency) ((void)0)
+#endif
+
+#endif
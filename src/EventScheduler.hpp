@@ -0,0 +1,170 @@
+#ifndef EVENTSCHEDULER_HPP
+#define EVENTSCHEDULER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Score.hpp"
+
+struct NoteEvent {
+    enum Type : uint8_t { On, Off };
+
+    uint64_t frame;      // absolute sample time
+    uint64_t sequence;   // insertion order, keeps equal times stable
+    int track;
+    Type type;
+    int note;            // pairs a note's On and Off
+    float frequency;
+    const ScoreParams *params;   // null: the voice's own parameters
+};
+
+// One time-ordered queue for the events of every track. Each callback pops
+// only the events that fall inside the block and hands them out with their
+// frame offset into it. Voices start and release on that exact sample,
+// independent of the block size. The cost per block is proportional to the
+// events due, not to the number of tracks or the length of the score.
+//
+// Notes come from addNote(), or are streamed from a ScoreFile. A streamed
+// score is read only a short window ahead of the playhead, so the queue
+// holds just the notes sounding or about to start.
+//
+// The queue is a heap in storage reserved up front. addNote() may grow it,
+// so call it off the audio thread. Streaming never does: while the queue
+// has no room for a note's two events, reading the score stops and picks up
+// again once events have been dispatched. A note held back past its start
+// plays at the start of the block it is finally read in.
+class EventScheduler {
+public:
+    explicit EventScheduler(size_t capacity = 1024){
+        queue.reserve(capacity);
+    }
+
+    void sampleRate(double sr){
+        rate = sr;
+    }
+    uint64_t now() const {
+        return nowFrame;
+    }
+
+    // Schedules a note `start` seconds after the current position and
+    // returns its note id. No voice is taken until the note starts.
+    int addNote(double start, double duration, int track, float frequency,
+                const ScoreParams *params = nullptr){
+        return schedule(nowFrame, start, duration, track, frequency, params);
+    }
+
+    // Plays `score` from the current position, reading its notes
+    // `lookahead` seconds before they start. The score must outlive the
+    // playback.
+    void stream(const ScoreFile &score, double lookahead = 1.0){
+        source = &score;
+        nextRecord = 0;
+        position.store(0, std::memory_order_relaxed);
+        streamStart = nowFrame;
+        lookaheadFrames = (uint64_t)std::llround(lookahead * rate);
+    }
+    // Index of the next score note the scheduler will read. Any thread may
+    // ask, e.g. to prefetch the records ahead of it.
+    size_t streamPosition() const {
+        return position.load(std::memory_order_relaxed);
+    }
+
+    // Calls listener(event) for every note-on as it is queued: when it is
+    // added, or for a streamed score, when it is read ahead of the
+    // playhead. The listener runs on the thread that adds or processes.
+    void onQueued(std::function<void(const NoteEvent &)> listener){
+        queued = std::move(listener);
+    }
+
+    // Calls dispatch(event, offset) for every event due in the next `frames`
+    // samples, in time order, then advances the clock by one block.
+    template <typename Dispatch>
+    void process(int frames, Dispatch &&dispatch){
+        uint64_t end = nowFrame + frames;
+        feed(end + lookaheadFrames);
+        while(!queue.empty() && queue.front().frame < end){
+            std::pop_heap(queue.begin(), queue.end(), Later());
+            NoteEvent e = queue.back();
+            queue.pop_back();
+            int offset = e.frame > nowFrame ? (int)(e.frame - nowFrame) : 0;
+            dispatch(e, offset);
+        }
+        nowFrame = end;
+    }
+
+    bool empty() const {
+        return queue.empty() && (!source || nextRecord >= source->size());
+    }
+
+private:
+    struct Later {
+        bool operator()(const NoteEvent &a, const NoteEvent &b) const {
+            return a.frame != b.frame ? a.frame > b.frame : a.sequence > b.sequence;
+        }
+    };
+
+    int schedule(uint64_t origin, double start, double duration, int track,
+                 float frequency, const ScoreParams *params){
+        uint64_t on = origin + (uint64_t)std::llround(start * rate);
+        uint64_t off = origin + (uint64_t)std::llround((start + duration) * rate);
+        int note = nextNote++;
+        push(on, track, NoteEvent::On, note, frequency, params);
+        push(off, track, NoteEvent::Off, note, frequency, params);
+        return note;
+    }
+
+    // queues the streamed notes that start before `until`, as far as the
+    // reserved storage holds them
+    void feed(uint64_t until){
+        while(source && nextRecord < source->size()
+              && queue.size() + 2 <= queue.capacity()){
+            const ScoreRecord &r = source->record(nextRecord);
+            if(!ScoreFile::playable(r)){
+                nextRecord++;
+                continue;
+            }
+            if(streamStart + (uint64_t)std::llround(r.start * rate) >= until){
+                break;
+            }
+            schedule(streamStart, r.start, r.duration, r.track, r.frequency, &source->params(r));
+            nextRecord++;
+        }
+        position.store(nextRecord, std::memory_order_relaxed);
+    }
+
+    void push(uint64_t frame, int track, NoteEvent::Type type, int note, float frequency,
+              const ScoreParams *params){
+        NoteEvent e;
+        e.frame = frame;
+        e.sequence = nextSequence++;
+        e.track = track;
+        e.type = type;
+        e.note = note;
+        e.frequency = frequency;
+        e.params = params;
+        queue.push_back(e);
+        std::push_heap(queue.begin(), queue.end(), Later());
+        if(type == NoteEvent::On && queued){
+            queued(e);
+        }
+    }
+
+    std::vector<NoteEvent> queue;   // heap, earliest event at front()
+    double rate = 44100.;
+    uint64_t nowFrame = 0;
+    uint64_t nextSequence = 0;
+    int nextNote = 0;
+    std::function<void(const NoteEvent &)> queued;
+
+    const ScoreFile *source = nullptr;
+    size_t nextRecord = 0;
+    std::atomic<size_t> position{0};
+    uint64_t streamStart = 0;
+    uint64_t lookaheadFrames = 0;
+};
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef EXCITATION_HPP
+#define EXCITATION_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Small per-voice generator (xorshift32). Reentrant and lock-free, unlike
+// rand(), and the same seed always gives the same sequence.
+class XorShift32 {
+public:
+    explicit XorShift32(uint32_t seed = 2463534242u) : state(seed ? seed : 1) {}
+
+    void seed(uint32_t s){
+        state = s ? s : 1;
+    }
+    uint32_t next(){
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    // uniform in [-0.5, 0.5)
+    float nextFloat(){
+        return (next() >> 8) * (1.f / 16777216.f) - 0.5f;
+    }
+
+private:
+    uint32_t state;
+};
+
+// A source of initial delay-line contents for a pluck.
+//
+// Sampled excitations are read as a window of consecutive samples. Shapes
+// describe one whole string and are stretched to the period of the string.
+struct Excitation {
+    const float *data;
+    int length;
+    bool shape;
+};
+
+// Excitation tables built once at startup, so a pluck is a copy instead of
+// running a random generator over the whole period. Noise tables are twice
+// the longest period, and a random offset picks a different window for each
+// pluck.
+class ExcitationBank {
+public:
+    enum Type { Noise, SoftNoise, PickNearBridge, PickCenter, numTypes };
+
+    static const int maxPeriod = 4096;
+    static const int noiseLength = 2 * maxPeriod;
+    static const int shapeLength = maxPeriod;
+
+    explicit ExcitationBank(uint32_t seed = 1)
+        : tables(numTypes) {
+        XorShift32 rng(seed);
+
+        // white, uniform in [-0.5, 0.5) like the original rand() pluck
+        tables[Noise].resize(noiseLength);
+        for(auto &x : tables[Noise]){
+            x = rng.nextFloat();
+        }
+
+        // one-pole lowpass for a darker, softer attack, rescaled to the
+        // same peak as the white table
+        tables[SoftNoise].resize(noiseLength);
+        float y = 0, peak = 0;
+        for(int i = 0; i < noiseLength; i++){
+            y += 0.3f * (tables[Noise][i] - y);
+            tables[SoftNoise][i] = y;
+            peak = std::max(peak, std::abs(y));
+        }
+        for(auto &x : tables[SoftNoise]){
+            x *= 0.5f / peak;
+        }
+
+        // triangular string displacement plucked at a fraction of its length
+        triangle(tables[PickNearBridge], 0.12f);
+        triangle(tables[PickCenter], 0.5f);
+    }
+
+    // Excitation of the given type. `random` picks the window within the
+    // noise tables and is ignored for shapes.
+    Excitation get(Type type, uint32_t random) const {
+        Excitation e;
+        if(type == PickNearBridge || type == PickCenter){
+            e.data = tables[type].data();
+            e.length = shapeLength;
+            e.shape = true;
+        } else {
+            e.data = tables[type].data() + random % (noiseLength - maxPeriod);
+            e.length = maxPeriod;
+            e.shape = false;
+        }
+        return e;
+    }
+
+    static const ExcitationBank &shared(){
+        static const ExcitationBank bank;
+        return bank;
+    }
+
+private:
+    void triangle(std::vector<float> &table, float position){
+        table.resize(shapeLength);
+        int apex = (int)(position * shapeLength);
+        for(int i = 0; i < shapeLength; i++){
+            float v = i < apex ? (float)i / apex
+                               : (float)(shapeLength - i) / (shapeLength - apex);
+            table[i] = 0.5f * v;
+        }
+        // remove the DC offset so the string settles around zero
+        float mean = 0;
+        for(float v : table){
+            mean += v;
+        }
+        mean /= shapeLength;
+        for(auto &v : table){
+            v -= mean;
+        }
+    }
+
+    std::vector<std::vector<float>> tables;
+};
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef FFT_HPP
+#define FFT_HPP
+
+#include <cmath>
+#include <vector>
+
+// Radix-2 FFT of a real signal of power-of-two length n. Internally the
+// signal is packed into an n/2-point complex FFT, and the result is
+// untangled afterwards. Spectra are stored split, as n/2 + 1 real parts
+// and n/2 + 1 imaginary parts (DC to Nyquist), so loops over bins
+// vectorize. Twiddles and scratch are allocated in the constructor;
+// forward() and inverse() do not allocate.
+class RealFFT {
+public:
+    explicit RealFFT(int n)
+        : n(n), m(n / 2),
+          re(m), im(m),
+          twCos(m / 2 + 1), twSin(m / 2 + 1),
+          untangleCos(m + 1), untangleSin(m + 1),
+          bitReverse(m) {
+        const double twoPi = 6.283185307179586;
+        for(int k = 0; k <= m / 2; k++){
+            twCos[k] = (float)std::cos(twoPi * k / m);
+            twSin[k] = (float)-std::sin(twoPi * k / m);
+        }
+        for(int k = 0; k <= m; k++){
+            untangleCos[k] = (float)std::cos(twoPi * k / n);
+            untangleSin[k] = (float)-std::sin(twoPi * k / n);
+        }
+        int bits = 0;
+        while((1 << bits) < m){
+            bits++;
+        }
+        for(int i = 0; i < m; i++){
+            int r = 0;
+            for(int b = 0; b < bits; b++){
+                r |= ((i >> b) & 1) << (bits - 1 - b);
+            }
+            bitReverse[i] = r;
+        }
+    }
+
+    int size() const {
+        return n;
+    }
+    int bins() const {
+        return m + 1;
+    }
+
+    // n samples in, bins() complex values out (unscaled)
+    void forward(const float *x, float *outRe, float *outIm){
+        for(int k = 0; k < m; k++){
+            int j = bitReverse[k];
+            re[j] = x[2 * k];
+            im[j] = x[2 * k + 1];
+        }
+        transform();
+        // X[k] = E[k] + W^k O[k], E and O recovered from Z[k] and Z[m-k]
+        for(int k = 0; k <= m; k++){
+            int a = k % m, b = (m - k) % m;
+            float er = 0.5f * (re[a] + re[b]), ei = 0.5f * (im[a] - im[b]);
+            float or_ = 0.5f * (im[a] + im[b]), oi = -0.5f * (re[a] - re[b]);
+            float c = untangleCos[k], s = untangleSin[k];
+            outRe[k] = er + c * or_ - s * oi;
+            outIm[k] = ei + c * oi + s * or_;
+        }
+    }
+
+    // bins() complex values in, n samples out, scaled so that
+    // inverse(forward(x)) == x
+    void inverse(const float *inRe, const float *inIm, float *x){
+        for(int k = 0; k < m; k++){
+            // E = (X[k] + conj X[m-k]) / 2, O = (X[k] - conj X[m-k]) W^-k / 2
+            float ar = inRe[k], ai = inIm[k];
+            float br = inRe[m - k], bi = -inIm[m - k];
+            float er = 0.5f * (ar + br), ei = 0.5f * (ai + bi);
+            float dr = 0.5f * (ar - br), di = 0.5f * (ai - bi);
+            float c = untangleCos[k], s = -untangleSin[k];
+            float or_ = dr * c - di * s, oi = dr * s + di * c;
+            // Z = E + iO, conjugated so the forward transform inverts it
+            int j = bitReverse[k];
+            re[j] = er - oi;
+            im[j] = -(ei + or_);
+        }
+        transform();
+        float scale = 1.f / m;
+        for(int k = 0; k < m; k++){
+            x[2 * k] = re[k] * scale;
+            x[2 * k + 1] = -im[k] * scale;
+        }
+    }
+
+private:
+    // in-place iterative radix-2 over bit-reversed input; the inverse runs
+    // it on the conjugate
+    void transform(){
+        for(int size = 2; size <= m; size <<= 1){
+            int half = size >> 1;
+            int step = m / size;
+            for(int start = 0; start < m; start += size){
+                for(int k = 0; k < half; k++){
+                    float c = twCos[k * step], s = twSin[k * step];
+                    int a = start + k, b = a + half;
+                    float tr = re[b] * c - im[b] * s;
+                    float ti = re[b] * s + im[b] * c;
+                    re[b] = re[a] - tr;
+                    im[b] = im[a] - ti;
+                    re[a] += tr;
+                    im[a] += ti;
+                }
+            }
+        }
+    }
+
+    int n, m;
+    std::vector<float> re, im;
+    std::vector<float> twCos, twSin;
+    std::vector<float> untangleCos, untangleSin;
+    std::vector<int> bitReverse;
+};
+
+#endif
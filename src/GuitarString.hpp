@@ -0,0 +1,45 @@
+#ifndef GUITARSTRING_HPP
+#define GUITARSTRING_HPP
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "DelayLine.hpp"
+#include "KarplusStrong.hpp"
+
+// Single plucked string with its own delay line. Voices use the pooled
+// GuitarStringBank; this is the reference model the bank is checked against.
+class GuitarString {
+public:
+    static const int maxDelay = 4096;     // 44100/20 Hz fits with room to spare
+
+    GuitarString(double freq){
+        itemSize = std::min((int)(44100/freq), maxDelay - 1);
+    }
+    void pluck(){
+        for(int i = 0; i < itemSize; i++){
+            double randVal = ((double) rand() / (RAND_MAX)) - 0.5;
+            ring.write(randVal);
+        }
+    }
+    void tic(){
+        karplusStrongSample(ring.data(), Line::mask, ring.position(), itemSize, gain);
+        ring.advance(1);
+    }
+    double sample(){
+        return ring.read(itemSize);
+    }
+    // Adds the next `frames` samples of the string into out and advances it,
+    // equivalent to calling sample() then tic() once per frame.
+    void process(float * out, int frames){
+        karplusStrongBlock(ring.data(), Line::mask, ring.position(), itemSize, gain, out, frames);
+        ring.advance(frames);
+    }
+private:
+    typedef DelayLine<float, maxDelay> Line;
+    static constexpr float gain = 0.5f * .996f;
+    Line ring;
+    int itemSize;
+};
+
+#endif
@@ -0,0 +1,278 @@
+#ifndef GUITARSTRINGBANK_HPP
+#define GUITARSTRINGBANK_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Excitation.hpp"
+#include "KarplusStrong.hpp"
+
+// A string rendered ahead of time (see NoteCache): `length` frames of its
+// output, followed by one period more. The output of a string over its
+// next period is what its delay line holds, so those extra samples are the
+// line at the end of the take. pin counts the banks reading the take and is
+// released when they stop.
+struct StringTake {
+    const float *samples;
+    int length;
+    std::atomic<int> *pin;
+};
+
+// Fixed set of Karplus-Strong strings stored structure-of-arrays: every
+// delay line is a slot of one contiguous arena, and the per-string write
+// heads, periods and loss gains sit in their own arrays. Rendering walks the
+// slots in order over the same memory block instead of chasing one heap
+// allocation per string.
+//
+// Strings have different periods, so lanes across strings would need
+// gathers and scatters on every sample. Each slot is instead processed with
+// the contiguous block kernel, which vectorizes along time (4/8/16 samples
+// per instruction depending on the target ISA).
+//
+// Slots are sized from the sample rate to hold the period of the lowest
+// note, minFrequency. All storage is allocated by the constructor. A string
+// whose delay line has decayed below silenceThreshold is retired and its
+// slot handed to the next pluck, so the cost of process() follows the
+// number of audible strings.
+// The two-point average never raises the largest sample in the line, so once
+// the line peak is under the threshold every later output is too.
+//
+// A slot can also play a StringTake instead of running the filter: its
+// output is copied from the take, and at the end of the take the line is
+// loaded from it and the string carries on as if it had been simulated all
+// along. The output, silence checks and retirement are the same bit for bit.
+class GuitarStringBank {
+public:
+    static const int minFrequency = 20;   // Hz, lowest string that fits a slot
+    static const int checkInterval = 8;   // blocks between silence checks
+
+    explicit GuitarStringBank(int numStrings = 8, double sampleRate = 44100,
+                              float silenceThreshold = 1e-4f)
+        : numStrings(numStrings),
+          rate(sampleRate),
+          silenceThreshold(silenceThreshold),
+          slotSize(slotLength(sampleRate)),
+          mask(slotSize - 1),
+          arena(new float[(size_t)numStrings * slotSize]()),
+          writePos(numStrings, 0),
+          lengths(numStrings, 0),
+          gains(numStrings, 0.f),
+          peaks(numStrings, 0.f),
+          countdown(numStrings, 0),
+          takes(numStrings, StringTake{nullptr, 0, nullptr}),
+          takePos(numStrings, 0) {
+        // stagger the checks so they do not all land on the same block
+        for(int s = 0; s < numStrings; s++){
+            countdown[s] = s % checkInterval;
+        }
+    }
+    ~GuitarStringBank(){
+        for(int s = 0; s < numStrings; s++){
+            endTake(s);
+        }
+    }
+    GuitarStringBank(const GuitarStringBank &) = delete;
+    GuitarStringBank &operator=(const GuitarStringBank &) = delete;
+
+    // Delay line capacity per string at sampleRate: the smallest power of
+    // two above the period of minFrequency, 4096 at 44.1 and 48 kHz.
+    static int slotLength(double sampleRate){
+        int n = 2;
+        while(n <= sampleRate / minFrequency + 1){
+            n *= 2;
+        }
+        return n;
+    }
+
+    // Delay line length of a string at freq. Frequencies under
+    // minFrequency, and zero, negative or NaN ones, play minFrequency.
+    static int period(double freq, double sampleRate){
+        if(!(freq >= minFrequency)){
+            freq = minFrequency;
+        }
+        return std::max(2, (int)(sampleRate/freq));
+    }
+    int period(double freq) const {
+        return period(freq, rate);
+    }
+
+    // Strings whose line peak falls under threshold are retired; 0 keeps
+    // every plucked string sounding, e.g. for benchmarks.
+    void retireBelow(float threshold){
+        silenceThreshold = threshold;
+    }
+
+    int size() const {
+        return numStrings;
+    }
+    int activeStrings() const {
+        return (int)std::count_if(lengths.begin(), lengths.end(),
+                                  [](int n){ return n > 0; });
+    }
+    // line peak of a slot at its last silence check, 0 when unused
+    float level(int slot) const {
+        return lengths[slot] > 0 ? peaks[slot] : 0.f;
+    }
+
+    // Starts a string at freq from the excitation in a free slot, or in the
+    // quietest sounding one when all are taken. Returns the slot index.
+    int pluck(double freq, const Excitation &excitation, float loss = .996f){
+        int slot = freeSlot();
+        int n = period(freq);
+        float * line = slotData(slot);
+        unsigned w = writePos[slot];
+        if(excitation.shape){
+            // stretch the shape over the period, 16.16 fixed-point steps
+            uint32_t step = ((uint32_t)excitation.length << 16) / n;
+            for(int i = 0; i < n; i++){
+                line[(w + i) & mask] = excitation.data[(i * step) >> 16];
+            }
+        } else if(n <= excitation.length){
+            // straight copy, split where the slot wraps
+            unsigned start = w & mask;
+            int first = std::min(n, (int)(slotSize - start));
+            std::copy(excitation.data, excitation.data + first, line + start);
+            std::copy(excitation.data + first, excitation.data + n, line);
+        } else {
+            // periods longer than the window, at high sample rates, repeat it
+            for(int i = 0; i < n; i++){
+                line[(w + i) & mask] = excitation.data[i % excitation.length];
+            }
+        }
+        writePos[slot] = w + n;
+        lengths[slot] = n;
+        gains[slot] = 0.5f * loss;
+        peaks[slot] = 0.5f;
+        return slot;
+    }
+
+    // Starts a string at freq that plays `take`, rendered with the same
+    // loss, instead of being simulated. Takes the pin on the take, which
+    // the caller must already hold, and releases it when done.
+    int pluck(double freq, const StringTake &take, float loss = .996f){
+        int slot = freeSlot();
+        takes[slot] = take;
+        takePos[slot] = 0;
+        lengths[slot] = period(freq);
+        gains[slot] = 0.5f * loss;
+        peaks[slot] = 0.5f;
+        return slot;
+    }
+
+    // Adds `frames` samples of every active string into out, retiring the
+    // strings that have gone silent.
+    void process(float * out, int frames){
+        for(int s = 0; s < numStrings; s++){
+            if(lengths[s] == 0){
+                continue;
+            }
+            int done = takes[s].samples ? playTake(s, out, frames) : 0;
+            karplusStrongBlock(slotData(s), mask, writePos[s], lengths[s],
+                               gains[s], out + done, frames - done);
+            writePos[s] += frames - done;
+
+            if(--countdown[s] < 0){
+                countdown[s] = checkInterval - 1;
+                peaks[s] = linePeak(s);
+                if(peaks[s] < silenceThreshold){
+                    retire(s);
+                }
+            }
+        }
+    }
+
+private:
+    float * slotData(int slot){
+        return arena.get() + (size_t)slot * slotSize;
+    }
+    // a free slot, or the quietest sounding one
+    int freeSlot(){
+        int slot = 0;
+        for(int s = 0; s < numStrings; s++){
+            if(lengths[s] == 0){
+                slot = s;
+                break;
+            }
+            if(peaks[s] < peaks[slot]){
+                slot = s;
+            }
+        }
+        endTake(slot);
+        return slot;
+    }
+
+    // Adds up to `frames` samples of a slot's take into out and returns how
+    // many. At the end of the take the slot's line is loaded from it, and
+    // the slot is simulated from then on.
+    int playTake(int slot, float * out, int frames){
+        const StringTake &take = takes[slot];
+        int pos = takePos[slot];
+        int n = std::min(frames, take.length - pos);
+        const float * src = take.samples + pos;
+        for(int i = 0; i < n; i++){
+            out[i] += src[i];
+        }
+        takePos[slot] = pos + n;
+        if(n < frames){
+            float * line = slotData(slot);
+            unsigned w = writePos[slot];
+            for(int i = 0; i < lengths[slot]; i++){
+                line[(w + i) & mask] = take.samples[take.length + i];
+            }
+            writePos[slot] = w + lengths[slot];
+            endTake(slot);
+        }
+        return n;
+    }
+    void endTake(int slot){
+        if(takes[slot].pin){
+            takes[slot].pin->fetch_sub(1, std::memory_order_release);
+        }
+        takes[slot] = StringTake{nullptr, 0, nullptr};
+    }
+
+    // largest magnitude in the live part of a slot's delay line, or the
+    // same samples still to come from its take
+    float linePeak(int slot){
+        if(takes[slot].samples){
+            const float * next = takes[slot].samples + takePos[slot];
+            float peak = 0;
+            for(int i = 0; i < lengths[slot]; i++){
+                peak = std::max(peak, std::abs(next[i]));
+            }
+            return peak;
+        }
+        const float * line = slotData(slot);
+        unsigned w = writePos[slot];
+        float peak = 0;
+        for(int i = 1; i <= lengths[slot]; i++){
+            peak = std::max(peak, std::abs(line[(w - i) & mask]));
+        }
+        return peak;
+    }
+    void retire(int slot){
+        endTake(slot);
+        lengths[slot] = 0;
+        peaks[slot] = 0;
+    }
+
+    int numStrings;
+    double rate;
+    float silenceThreshold;
+    int slotSize;                     // power of two, see slotLength()
+    unsigned mask;                    // slotSize - 1
+    std::unique_ptr<float[]> arena;   // numStrings slots of slotSize samples
+    std::vector<unsigned> writePos;   // next write position per slot
+    std::vector<int> lengths;         // period in samples, 0 = unused slot
+    std::vector<float> gains;         // 0.5 * loss per slot
+    std::vector<float> peaks;         // line peak at the last check
+    std::vector<int> countdown;       // blocks until the next check
+    std::vector<StringTake> takes;    // samples null: simulated
+    std::vector<int> takePos;         // frames of the take played
+};
+
+#endif
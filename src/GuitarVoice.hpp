@@ -0,0 +1,278 @@
+#ifndef GUITARVOICE_HPP
+#define GUITARVOICE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Gamma/Effects.h"
+#include "Gamma/Envelope.h"
+#include "al/scene/al_PolySynth.hpp"
+
+#include "EventLog.hpp"
+#include "Excitation.hpp"
+#include "GuitarStringBank.hpp"
+#include "InstrumentGroup.hpp"
+#include "LoadMeter.hpp"
+#include "NoteCache.hpp"
+#include "VoiceParams.hpp"
+
+class GuitarVoice : public al::SynthVoice
+{
+public:
+    // Unit generators
+    gam::Pan<> mPan;
+    gam::Env<3> mAmpEnv;
+    static const int maxBlockSize = 4096; // scratch size until prepare()
+
+    GuitarStringBank notesPlayed{8, gam::sampleRate()};
+    std::vector<float> stringBlock; // summed string output for one block
+
+    // Parameter handles, resolved in init() and read once per block
+    SmoothedParam mAmplitude;
+    VoiceParam mFrequency;
+    VoiceParam mAttackTime;
+    VoiceParam mReleaseTime;
+    VoiceParam mPanPos;
+    VoiceParam mExcitation;
+
+    XorShift32 mRandom{nextSeed()};   // picks the excitation window per pluck
+
+    // The trigger parameters other than frequency as plain values, to hand
+    // between threads. The defaults are init()'s.
+    struct Settings {
+        float amplitude = 0.3f;
+        float attackTime = 0.1f;
+        float releaseTime = 0.1f;
+        float pan = 0.f;
+        float excitation = 0.f;
+    };
+
+    // Reads the parameters by name; for the GUI thread's preset voice.
+    Settings settings() {
+        Settings s;
+        s.amplitude = getInternalParameterValue("amplitude");
+        s.attackTime = getInternalParameterValue("attackTime");
+        s.releaseTime = getInternalParameterValue("releaseTime");
+        s.pan = getInternalParameterValue("pan");
+        s.excitation = getInternalParameterValue("excitation");
+        return s;
+    }
+    // Writes them through the handles, without name lookups; for the audio
+    // thread setting up a voice before it is triggered.
+    void settings(const Settings &s) {
+        mAmplitude.set(s.amplitude);
+        mAttackTime.set(s.attackTime);
+        mReleaseTime.set(s.releaseTime);
+        mPanPos.set(s.pan);
+        mExcitation.set(s.excitation);
+    }
+
+    // when set, amplitude and attack come from the group instead
+    InstrumentGroup *mGroup = nullptr;
+
+    void group(InstrumentGroup *g) { mGroup = g; }
+
+    // when set, plucks use a fixed excitation window per frequency and
+    // play the cache's take of the string when it has one
+    NoteCache *mCache = nullptr;
+
+    void cache(NoteCache *c) { mCache = c; }
+
+    // Releases the note at a frame of the next block rendered, for
+    // sample-accurate note-offs from the scheduler.
+    void releaseAt(int frame) {
+        mReleaseFrame = frame;
+        LOG_VOICE_EVENT(NoteOff, id(), mFrequency.get());
+    }
+
+    // Plucks the sounding note again at a frame of the next block. Strings
+    // still ringing keep ringing, like a player re-striking the same note.
+    void retriggerAt(int frame) {
+        mRetriggerFrame = frame;
+        mReleaseFrame = -1;
+    }
+
+    // Fades the voice to silence over `seconds` from a frame of the next
+    // block, then frees it. Used when the voice is stolen for another note.
+    void fadeOutAt(int frame, float seconds) {
+        mFadeFrame = frame;
+        mFadeSeconds = seconds;
+    }
+    bool fading() const { return mFadeFrame >= 0 || mFadeStep > 0; }
+
+    // peak output of the last block rendered
+    float level() const { return mLevel; }
+
+    void init() override
+    {
+        mAmpEnv.curve(0); // make segments lines
+        mAmpEnv.levels(0, 1, 1, 0);
+        mAmpEnv.sustainPoint(2); // Make point 2 sustain until a release is issued
+
+        // keep allocation off the audio thread
+        prepare(maxBlockSize);
+        ExcitationBank::shared();
+
+        mAmplitude.bind(createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0));
+        mFrequency.bind(createInternalTriggerParameter("frequency", 60, 20, 5000));
+        mAttackTime.bind(createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0));
+        mReleaseTime.bind(createInternalTriggerParameter("releaseTime", 0.1, 0.1, 10.0));
+        mPanPos.bind(createInternalTriggerParameter("pan", 0.0, -1.0, 1.0));
+        // 0 noise, 1 soft noise, 2 picked near the bridge, 3 picked at center
+        mExcitation.bind(createInternalTriggerParameter("excitation", 0, 0, ExcitationBank::numTypes - 1));
+    }
+
+    // Sizes the string scratch for blocks of up to maxFrames. Larger blocks
+    // still render, in chunks of maxFrames. Call before audio starts.
+    void prepare(int maxFrames)
+    {
+        stringBlock.assign(std::max(1, maxFrames), 0.f);
+    }
+
+    // The audio processing function
+    void onProcess(al::AudioIOData &io) override
+    {
+        render(io.outBuffer(0), io.outBuffer(1), io.frame() + 1,
+               io.framesPerBuffer(), io.framesPerSecond());
+    }
+
+    // Adds the note into frames [start, blockFrames) of a block held in
+    // left and right. onProcess() without the AudioIOData, so the caller
+    // can size its own buffers.
+    void render(float *left, float *right, int start, int blockFrames, double sampleRate)
+    {
+        LOAD_METER_VOICE_BEGIN();
+        int frames = blockFrames - start;
+        float attack;
+        if (mGroup) {
+            mAmplitude.snapshot(frames, mGroup->amplitude.load(std::memory_order_relaxed));
+            attack = mGroup->attackTime.load(std::memory_order_relaxed);
+        } else {
+            mAmplitude.snapshot(frames);
+            attack = mAttackTime.snapshot();
+        }
+
+        mAmpEnv.lengths()[0] = attack;
+        mAmpEnv.lengths()[2] = mReleaseTime.snapshot();
+        mPan.pos(mPanPos.snapshot());
+
+        int release = pendingFrame(mReleaseFrame, start);
+        int retrigger = pendingFrame(mRetriggerFrame, start);
+        int fade = pendingFrame(mFadeFrame, start);
+        float fadeStep = 1.f / std::max(1.f, mFadeSeconds * (float)sampleRate);
+
+        // render every string in one pass each per chunk of stringBlock,
+        // or in two around a retrigger; larger blocks go in several chunks
+        float peak = 0;
+        int chunk = (int)stringBlock.size();
+        for (int done = 0; done < frames; done += chunk)
+        {
+            int count = std::min(chunk, frames - done);
+            renderStrings(count, retrigger - done,
+                          retrigger >= done && done + count == frames);
+            for (int i = 0; i < count; i++)
+            {
+                int n = done + i;
+                if (n == release)
+                    mAmpEnv.release();
+                if (n == retrigger && mAmpEnv.released())
+                    mAmpEnv.resetSoft();
+                if (n == fade)
+                    mFadeStep = fadeStep;
+                float s1 = stringBlock[i] * mAmpEnv() * mAmplitude.next() * mFadeGain * 3;
+                mFadeGain = std::max(0.f, mFadeGain - mFadeStep);
+                float s2;
+                mPan(s1, s1, s2);
+                left[start + n] += s1;
+                right[start + n] += s2;
+                peak = std::max(peak, std::abs(s1));
+            }
+        }
+        mLevel = peak;
+        if (mAmpEnv.done() || mFadeGain <= 0.f)
+            free();
+        LOAD_METER_VOICE_END(notesPlayed.activeStrings());
+    }
+
+    void onTriggerOn() override {
+        mAmpEnv.reset();
+        mReleaseFrame = -1;
+        mRetriggerFrame = -1;
+        mFadeFrame = -1;
+        mFadeGain = 1.f;
+        mFadeStep = 0.f;
+        mLevel = 0.f;
+        if (mGroup) {
+            mAmplitude.reset(mGroup->amplitude.load(std::memory_order_relaxed));
+        } else {
+            mAmplitude.reset();
+        }
+        pluck();
+    }
+
+    void onTriggerOff() override {
+        LOG_VOICE_EVENT(NoteOff, id(), mFrequency.get());
+        mAmpEnv.release();
+    }
+    void update(double dt) override{
+    }
+
+private:
+    // Fills stringBlock with the next `frames` samples of the strings. When
+    // `retrigger` falls inside them, or at or past their end with `last`
+    // set, the strings are plucked again at that frame.
+    void renderStrings(int frames, int retrigger, bool last) {
+        std::fill(stringBlock.begin(), stringBlock.begin() + frames, 0.f);
+        if (retrigger >= 0 && (retrigger < frames || last)) {
+            retrigger = std::min(retrigger, frames);
+            notesPlayed.process(stringBlock.data(), retrigger);
+            pluck();
+            notesPlayed.process(stringBlock.data() + retrigger, frames - retrigger);
+        } else {
+            notesPlayed.process(stringBlock.data(), frames);
+        }
+    }
+
+    void pluck() {
+        float f = mFrequency.snapshot();
+        int type = (int)mExcitation.snapshot();
+        StringTake take;
+        if (!mCache) {
+            notesPlayed.pluck(f, ExcitationBank::shared().get(
+                (ExcitationBank::Type)type, mRandom.next()));
+        } else if (mCache->take(f, type, take)) {
+            notesPlayed.pluck(f, take);
+        } else {
+            notesPlayed.pluck(f, ExcitationBank::shared().get(
+                (ExcitationBank::Type)type, NoteCache::seed(f)));
+        }
+        LOG_VOICE_EVENT(NoteOn, id(), f);
+    }
+
+    // consumes a frame requested for the next block, relative to where
+    // this block starts rendering; -1 when none is pending
+    static int pendingFrame(int &frame, int start) {
+        int n = frame >= 0 ? std::max(0, frame - start) : -1;
+        frame = -1;
+        return n;
+    }
+
+    // distinct, reproducible seeds in voice construction order
+    static uint32_t nextSeed() {
+        static std::atomic<uint32_t> counter{0};
+        return 0x9E3779B9u * (counter.fetch_add(1, std::memory_order_relaxed) + 1);
+    }
+
+    int mReleaseFrame = -1;
+    int mRetriggerFrame = -1;
+    int mFadeFrame = -1;
+    float mFadeSeconds = 0.005f;
+    float mFadeGain = 1.f;
+    float mFadeStep = 0.f;
+    float mLevel = 0.f;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef IMPULSERESPONSE_HPP
+#define IMPULSERESPONSE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+// Loads the first channel of an impulse response. WAV files may be 16-bit
+// PCM or 32-bit float; any other file is read as headerless mono float32.
+// Returns false if the file cannot be read or is not a supported format.
+inline bool loadImpulseResponse(const std::string &path, std::vector<float> &ir,
+                                double &sampleRate){
+    MappedFile file(path);
+    const uint8_t *p = file.data();
+    size_t size = file.size();
+    if(!p){
+        return false;
+    }
+    auto u16 = [](const uint8_t *b){ return (uint32_t)b[0] | (uint32_t)b[1] << 8; };
+    auto u32 = [u16](const uint8_t *b){ return u16(b) | u16(b + 2) << 16; };
+
+    if(size < 12 || std::memcmp(p, "RIFF", 4) != 0 || std::memcmp(p + 8, "WAVE", 4) != 0){
+        ir.resize(size / sizeof(float));
+        std::memcpy(ir.data(), p, ir.size() * sizeof(float));
+        return !ir.empty();
+    }
+
+    int format = 0, channels = 0, bits = 0;
+    size_t pos = 12;
+    while(pos + 8 <= size){
+        uint32_t chunk = u32(p + pos + 4);
+        const uint8_t *body = p + pos + 8;
+        bool data = std::memcmp(p + pos, "data", 4) == 0;
+        // a data chunk cut short is read up to the end of the file; any
+        // other chunk running past it means the file is corrupt
+        if(!data && chunk > size - (pos + 8)){
+            return false;
+        }
+        if(std::memcmp(p + pos, "fmt ", 4) == 0 && chunk >= 16 && pos + 8 + 16 <= size){
+            format = (int)u16(body);
+            channels = (int)u16(body + 2);
+            sampleRate = u32(body + 4);
+            bits = (int)u16(body + 14);
+        } else if(data && channels > 0){
+            size_t available = std::min<size_t>(chunk, size - (pos + 8));
+            size_t frameBytes = (size_t)channels * bits / 8;
+            size_t frames = frameBytes ? available / frameBytes : 0;
+            ir.resize(frames);
+            for(size_t i = 0; i < frames; i++){
+                const uint8_t *s = body + i * frameBytes;
+                if(format == 3 && bits == 32){
+                    std::memcpy(&ir[i], s, sizeof(float));
+                } else if(format == 1 && bits == 16){
+                    ir[i] = (int16_t)u16(s) / 32768.f;
+                } else {
+                    return false;
+                }
+            }
+            return !ir.empty();
+        }
+        pos += 8 + chunk + (chunk & 1);
+    }
+    return false;
+}
+
+// Stand-in body response when no IR file is given: the direct sound plus a
+// handful of decaying modes at typical acoustic guitar body resonances
+// (air cavity, top and back plate), scaled to unit energy.
+inline std::vector<float> syntheticBodyIR(double sampleRate, double seconds = 0.3){
+    struct Mode { double freq, decay, gain; };
+    static const Mode modes[] = {
+        {98, 0.12, 0.9}, {204, 0.09, 1.0}, {250, 0.07, 0.6}, {378, 0.05, 0.5},
+        {440, 0.04, 0.4}, {560, 0.035, 0.35}, {730, 0.03, 0.3}, {960, 0.02, 0.25},
+        {1250, 0.015, 0.2}, {1800, 0.01, 0.15},
+    };
+    const double twoPi = 6.283185307179586;
+    std::vector<float> ir((size_t)(seconds * sampleRate));
+    ir[0] = 1.f;
+    for(const Mode &m : modes){
+        for(size_t i = 1; i < ir.size(); i++){
+            double t = i / sampleRate;
+            ir[i] += (float)(0.02 * m.gain * std::exp(-t / m.decay) * std::sin(twoPi * m.freq * t));
+        }
+    }
+    double energy = 0;
+    for(float v : ir){
+        energy += v * v;
+    }
+    float scale = (float)(1.0 / std::sqrt(energy));
+    for(auto &v : ir){
+        v *= scale;
+    }
+    return ir;
+}
+
+#endif
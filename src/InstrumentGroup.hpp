@@ -0,0 +1,37 @@
+#ifndef INSTRUMENTGROUP_HPP
+#define INSTRUMENTGROUP_HPP
+
+#include <algorithm>
+#include <atomic>
+
+// Parameters shared by every voice of one instrument. The UI thread changes
+// a value with a single atomic store; each voice bound to the group picks it
+// up at the start of its next block, so adjusting a track costs the same no
+// matter how many voices it has scheduled. Ranges match the voices' own
+// trigger parameters.
+class InstrumentGroup {
+public:
+    std::atomic<float> amplitude{0.3f};
+    std::atomic<float> attackTime{0.1f};
+
+    void set(float amp, float attack){
+        amplitude.store(clamp(amp, 0.f, 1.f), std::memory_order_relaxed);
+        attackTime.store(clamp(attack, 0.01f, 3.f), std::memory_order_relaxed);
+    }
+    // only the UI thread writes, so load-then-store does not lose updates
+    void adjustAmplitude(float delta){
+        float v = amplitude.load(std::memory_order_relaxed) + delta;
+        amplitude.store(clamp(v, 0.f, 1.f), std::memory_order_relaxed);
+    }
+    void adjustAttackTime(float delta){
+        float v = attackTime.load(std::memory_order_relaxed) + delta;
+        attackTime.store(clamp(v, 0.01f, 3.f), std::memory_order_relaxed);
+    }
+
+private:
+    static float clamp(float v, float lo, float hi){
+        return std::min(std::max(v, lo), hi);
+    }
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef KARPLUSSTRONG_HPP
+#define KARPLUSSTRONG_HPP
+
+#include "DspKernels.hpp"
+
+// Karplus-Strong update shared by GuitarString and GuitarStringBank.
+//
+// A string of period `length` lives in a power-of-two delay line (`mask` =
+// capacity - 1) whose next write goes to `writePos`. Each sample outputs the
+// tap `length` samples back and writes gain * (that tap + the following one)
+// at the write head, where gain folds the two-point average and the loss.
+//
+// A tiny constant is added to every write. An undamped string keeps
+// shrinking by the loss factor, and without it would decay into denormals,
+// which are very slow on x86. With it the line settles at a DC level of
+// bias / (1 - 2 * gain), about 2.5e-16 at the default loss. That is far
+// below audibility and far above the denormal range, and it costs one add.
+const float karplusStrongBias = 1e-18f;
+
+inline float karplusStrongSample(float * line, unsigned mask,
+                                 unsigned writePos, int length, float gain){
+    unsigned r = (writePos - length) & mask;
+    float a = line[r];
+    line[writePos & mask] = (a + line[(r + 1) & mask]) * gain + karplusStrongBias;
+    return a;
+}
+
+// Block form: adds `frames` samples into out. The caller advances its write
+// position by `frames` afterwards. Work is split into runs where neither head
+// wraps and no sample read in the run is written by it, so the inner loop is
+// a plain contiguous add/multiply the compiler can vectorize. The loop lives
+// in DspKernels.inl, built for each instruction set the library supports.
+inline void karplusStrongBlock(float * line, unsigned mask, unsigned writePos,
+                               int length, float gain, float * out, int frames){
+    dspKernels().karplusStrongBlock(line, mask, writePos, length, gain, out, frames);
+}
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef LATENCYMANAGER_HPP
+#define LATENCYMANAGER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "al/io/al_AudioIOData.hpp"
+
+#include "LoadMeter.hpp"
+
+// Picks the audio block size from measured DSP load: the smallest one the
+// machine can sustain, for the lowest latency.
+//
+// At startup, probe() renders a worst case (the caller's choice, e.g. every
+// voice sounding) offline at each candidate size, smallest first. It keeps
+// the first size whose p99 callback time stays under probeTarget percent of
+// the block period.
+//
+// While running, update() takes each load reading. One over raiseAbove, or
+// a new xrun, steps up a size at once. Stepping back down needs every
+// reading for lowerAfter seconds to be under lowerBelow. The gap between
+// the two thresholds keeps the size from flapping. Readings within
+// settle seconds of a change are ignored while the device restarts.
+class LatencyManager {
+public:
+    static constexpr double probeTarget = 50;   // percent of the period, p99
+    static constexpr double raiseAbove = 80;
+    static constexpr double lowerBelow = 30;
+    static constexpr double lowerAfter = 10;    // seconds
+    static constexpr double settle = 1;         // seconds
+
+    explicit LatencyManager(std::vector<int> sizes = {64, 128, 256, 512})
+        : sizes(std::move(sizes)), current((int)this->sizes.size() - 1) {}
+
+    int blockSize() const {
+        return sizes[current];
+    }
+    // largest size update() may switch to
+    int maxBlockSize() const {
+        return sizes.back();
+    }
+    double latencySeconds(double sampleRate) const {
+        return blockSize() / sampleRate;
+    }
+
+    // Calls render(io, start) for `seconds` of audio at each size, with
+    // start set on the first block of each size, and returns the size
+    // chosen. Call before audio starts; it allocates.
+    template <typename Render>
+    int probe(Render &&render, double sampleRate, int channels, double seconds = 0.25){
+        typedef std::chrono::steady_clock Clock;
+        al::AudioIOData io;
+        io.framesPerSecond(sampleRate);
+        io.channelsOut(channels);
+        current = (int)sizes.size() - 1;
+        for(int k = 0; k < (int)sizes.size(); k++){
+            int frames = sizes[k];
+            io.framesPerBuffer(frames);
+            int blocks = std::max(8, (int)(seconds * sampleRate / frames));
+            std::vector<double> loads(blocks);
+            double periodNs = 1e9 * frames / sampleRate;
+            for(int b = 0; b < blocks; b++){
+                io.zeroOut();
+                io.frame(0);
+                Clock::time_point start = Clock::now();
+                render(io, b == 0);
+                double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Clock::now() - start).count();
+                loads[b] = 100 * ns / periodNs;
+            }
+            // the first blocks warm caches and are not representative
+            std::sort(loads.begin() + 2, loads.end());
+            double p99 = loads[2 + (int)(0.99 * (blocks - 3))];
+            if(p99 < probeTarget){
+                current = k;
+                break;
+            }
+        }
+        resetRunning();
+        return blockSize();
+    }
+
+    // Feeds one load reading covering `dt` seconds. Returns true when the
+    // block size should change to blockSize().
+    bool update(const LoadStats &s, double dt){
+        uint32_t newXruns = s.xruns - xruns;
+        xruns = s.xruns;
+        if(sinceChange < settle){
+            sinceChange += dt;
+            return false;
+        }
+        sinceChange += dt;
+        if(s.callbacks == 0){
+            return false;
+        }
+        if((s.p99 > raiseAbove || newXruns > 0) && current + 1 < (int)sizes.size()){
+            current++;
+            resetRunning();
+            return true;
+        }
+        calm = s.p99 < lowerBelow ? calm + dt : 0;
+        if(calm >= lowerAfter && current > 0){
+            current--;
+            resetRunning();
+            return true;
+        }
+        return false;
+    }
+
+private:
+    void resetRunning(){
+        sinceChange = 0;
+        calm = 0;
+    }
+
+    std::vector<int> sizes;   // ascending
+    int current;
+    uint32_t xruns = 0;
+    double sinceChange = 0;   // seconds at the current size
+    double calm = 0;          // seconds of readings under lowerBelow
+};
+
+#endif
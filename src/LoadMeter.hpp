@@ -0,0 +1,270 @@
+#ifndef LOADMETER_HPP
+#define LOADMETER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+
+#include "al/io/al_AudioIOData.hpp"
+
+// Build with -DGUITAR_LOAD_METER=0 to compile the callback and voice timers
+// away.
+#ifndef GUITAR_LOAD_METER
+#define GUITAR_LOAD_METER 1
+#endif
+
+// Histogram with fixed-width bins and one overflow bin, plus the running
+// maximum. Any thread may add() without locking. The reader calls take(),
+// which empties the bins one atomic exchange at a time. Each reading
+// therefore covers exactly the values added since the one before.
+template <int Bins>
+class AtomicHistogram {
+public:
+    struct Summary {
+        uint64_t count = 0;
+        double p50 = 0;
+        double p99 = 0;
+        double max = 0;
+    };
+
+    explicit AtomicHistogram(double binWidth) : width(binWidth) {
+        for(auto &c : counts){
+            c.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void add(double v){
+        int b = std::min(Bins, std::max(0, (int)(v / width)));
+        counts[b].fetch_add(1, std::memory_order_relaxed);
+        float m = maxValue.load(std::memory_order_relaxed);
+        while(v > m && !maxValue.compare_exchange_weak(m, (float)v, std::memory_order_relaxed)){
+        }
+    }
+
+    // Percentiles are upper bin edges, so they never under-report. Values
+    // in the overflow bin report the maximum.
+    Summary take(){
+        uint32_t taken[Bins + 1];
+        Summary s;
+        for(int b = 0; b <= Bins; b++){
+            taken[b] = counts[b].exchange(0, std::memory_order_relaxed);
+            s.count += taken[b];
+        }
+        s.max = maxValue.exchange(0.f, std::memory_order_relaxed);
+        s.p50 = percentile(taken, s.count, 0.50, s.max);
+        s.p99 = percentile(taken, s.count, 0.99, s.max);
+        return s;
+    }
+
+private:
+    double percentile(const uint32_t *taken, uint64_t total, double q, double max) const {
+        if(total == 0){
+            return 0;
+        }
+        uint64_t rank = (uint64_t)(q * (total - 1)) + 1;
+        uint64_t seen = 0;
+        for(int b = 0; b < Bins; b++){
+            seen += taken[b];
+            if(seen >= rank){
+                return std::min(max, (b + 1) * width);
+            }
+        }
+        return max;
+    }
+
+    double width;
+    std::atomic<uint32_t> counts[Bins + 1];
+    std::atomic<float> maxValue{0.f};
+};
+
+// What the meter saw since it was last read.
+struct LoadStats {
+    uint64_t callbacks = 0;
+    double p50 = 0;         // callback time, percent of the block period
+    double p99 = 0;
+    double max = 0;
+    double voiceP50 = 0;    // one voice's onProcess, microseconds
+    double voiceP99 = 0;
+    double voiceMax = 0;
+    uint32_t xruns = 0;     // since startup
+    int voices = 0;         // rendered in the last callback
+    int strings = 0;        // sounding in the last callback
+};
+
+// DSP load instrumentation. The audio callback is timed with a Scope, and
+// every voice reports its own onProcess time. Both go into lock-free
+// histograms, so any thread may record. The UI or another background
+// thread calls read() to get percentiles since its previous read.
+//
+// A callback counts as an xrun when it runs longer than its block period,
+// or when it starts more than two periods after the one before. The second
+// case means the device was starved even though the callbacks were fast.
+// When the device is stopped and reopened on purpose, restart() keeps the
+// gap from counting.
+class LoadMeter {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    LoadMeter() : callbackTimes(0.5), voiceTimes(1.0) {}
+
+    // Times one audio callback; construct at the top of onSound().
+    class Scope {
+    public:
+        Scope(LoadMeter &meter, const al::AudioIOData &io) : meter(meter) {
+            meter.beginCallback(io.framesPerBuffer() / io.framesPerSecond());
+        }
+        ~Scope(){
+            meter.endCallback();
+        }
+    private:
+        LoadMeter &meter;
+    };
+
+    void beginCallback(double periodSeconds){
+        Clock::time_point now = Clock::now();
+        periodNs = periodSeconds * 1e9;
+        if(started && nanos(lastStart, now) > 2 * periodNs){
+            xruns.fetch_add(1, std::memory_order_relaxed);
+        }
+        lastStart = now;
+        started = true;
+    }
+
+    // The next callback starts a new stream; the time since the last one
+    // is not an xrun. Call while no callback runs, e.g. between stopping
+    // and starting the device.
+    void restart(){
+        started = false;
+    }
+
+    void endCallback(){
+        double ns = nanos(lastStart, Clock::now());
+        double load = periodNs > 0 ? 100 * ns / periodNs : 0;
+        callbackTimes.add(load);
+        if(load > 100){
+            xruns.fetch_add(1, std::memory_order_relaxed);
+        }
+        lastVoices.store(voiceCount.exchange(0, std::memory_order_relaxed),
+                         std::memory_order_relaxed);
+        lastStrings.store(stringCount.exchange(0, std::memory_order_relaxed),
+                          std::memory_order_relaxed);
+    }
+
+    // called by each voice at the end of its onProcess()
+    void voiceProcessed(Clock::time_point start, int strings){
+        voiceTimes.add(nanos(start, Clock::now()) * 1e-3);
+        voiceCount.fetch_add(1, std::memory_order_relaxed);
+        stringCount.fetch_add(strings, std::memory_order_relaxed);
+    }
+
+    LoadStats read(){
+        LoadStats s;
+        AtomicHistogram<bins>::Summary c = callbackTimes.take();
+        AtomicHistogram<bins>::Summary v = voiceTimes.take();
+        s.callbacks = c.count;
+        s.p50 = c.p50;
+        s.p99 = c.p99;
+        s.max = c.max;
+        s.voiceP50 = v.p50;
+        s.voiceP99 = v.p99;
+        s.voiceMax = v.max;
+        s.xruns = xruns.load(std::memory_order_relaxed);
+        s.voices = lastVoices.load(std::memory_order_relaxed);
+        s.strings = lastStrings.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    static void writeCsvHeader(std::ostream &out){
+        out << "time_s,callbacks,load_p50_pct,load_p99_pct,load_max_pct,"
+               "voice_p50_us,voice_p99_us,voice_max_us,xruns,voices,strings\n";
+    }
+    static void writeCsvRow(std::ostream &out, double time, const LoadStats &s){
+        out << time << ',' << s.callbacks << ',' << s.p50 << ',' << s.p99 << ','
+            << s.max << ',' << s.voiceP50 << ',' << s.voiceP99 << ',' << s.voiceMax
+            << ',' << s.xruns << ',' << s.voices << ',' << s.strings << '\n';
+    }
+
+private:
+    // 0.5% bins up to 200% of the period, 1 us bins up to 400 us per voice
+    static const int bins = 400;
+
+    static double nanos(Clock::time_point a, Clock::time_point b){
+        return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(b - a).count();
+    }
+
+    AtomicHistogram<bins> callbackTimes;
+    AtomicHistogram<bins> voiceTimes;
+    std::atomic<uint32_t> xruns{0};
+    std::atomic<int> voiceCount{0};
+    std::atomic<int> stringCount{0};
+    std::atomic<int> lastVoices{0};
+    std::atomic<int> lastStrings{0};
+
+    // audio thread only, and restart() while no callback runs
+    Clock::time_point lastStart;
+    double periodNs = 0;
+    bool started = false;
+};
+
+inline LoadMeter &loadMeter(){
+    static LoadMeter meter;
+    return meter;
+}
+
+// Reads the meter from a UI or offline loop every `interval` seconds. It
+// keeps the latest reading for display, and can append each one to a CSV
+// file.
+class LoadReport {
+public:
+    explicit LoadReport(double interval = 0.5) : interval(interval) {}
+
+    bool csv(const std::string &path){
+        file.open(path);
+        if(file){
+            LoadMeter::writeCsvHeader(file);
+        }
+        return (bool)file;
+    }
+
+    // Returns true when a new reading was taken.
+    bool update(double dt){
+        elapsed += dt;
+        time += dt;
+        if(elapsed < interval){
+            return false;
+        }
+        elapsed = 0;
+        stats = loadMeter().read();
+        if(file.is_open()){
+            LoadMeter::writeCsvRow(file, time, stats);
+        }
+        return true;
+    }
+
+    const LoadStats &latest() const {
+        return stats;
+    }
+
+private:
+    double interval;
+    double elapsed = 0;
+    double time = 0;
+    LoadStats stats;
+    std::ofstream file;
+};
+
+#if GUITAR_LOAD_METER
+#define LOAD_METER_CALLBACK(io) LoadMeter::Scope loadMeterScope_(loadMeter(), io)
+#define LOAD_METER_VOICE_BEGIN() LoadMeter::Clock::time_point loadMeterStart_ = LoadMeter::Clock::now()
+#define LOAD_METER_VOICE_END(strings) loadMeter().voiceProcessed(loadMeterStart_, strings)
+#else
+#define LOAD_METER_CALLBACK(io) ((void)0)
+#define LOAD_METER_VOICE_BEGIN() ((void)0)
+#define LOAD_METER_VOICE_END(strings) ((void)0)
+#endif
+
+#endif
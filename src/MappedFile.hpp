@@ -0,0 +1,92 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPED_FILE_MMAP 1
+#else
+#include <fstream>
+#include <iterator>
+#define MAPPED_FILE_MMAP 0
+#endif
+
+// Read-only view of a whole file. On POSIX systems the file is mapped, so
+// large files (long IRs, hour-long scores) are paged in as they are read
+// instead of being copied through a stream buffer first. Elsewhere the
+// file is read into memory.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path){
+#if MAPPED_FILE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0){
+            return;
+        }
+        struct stat st;
+        if(::fstat(fd, &st) == 0 && st.st_size > 0){
+            void *p = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p != MAP_FAILED){
+                bytes = (const uint8_t *)p;
+                length = (size_t)st.st_size;
+            }
+        }
+        ::close(fd);
+#else
+        std::ifstream in(path, std::ios::binary);
+        fallback.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        bytes = fallback.empty() ? nullptr : (const uint8_t *)fallback.data();
+        length = fallback.size();
+#endif
+    }
+    ~MappedFile(){
+#if MAPPED_FILE_MMAP
+        if(bytes){
+            ::munmap((void *)bytes, length);
+        }
+#endif
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const uint8_t *data() const {
+        return bytes;
+    }
+    size_t size() const {
+        return length;
+    }
+
+    // Asks the OS to start reading a byte range in the background, so a
+    // later access from the audio thread does not wait on the disk.
+    void willNeed(size_t offset, size_t count) const {
+#if MAPPED_FILE_MMAP
+        if(!bytes || offset >= length){
+            return;
+        }
+        size_t page = (size_t)::sysconf(_SC_PAGESIZE);
+        size_t begin = offset / page * page;
+        size_t end = std::min(length, offset + count);
+        ::madvise((void *)(bytes + begin), end - begin, MADV_WILLNEED);
+#else
+        (void)offset;
+        (void)count;
+#endif
+    }
+
+private:
+    const uint8_t *bytes = nullptr;
+    size_t length = 0;
+#if !MAPPED_FILE_MMAP
+    std::vector<char> fallback;
+#endif
+};
+
+#endif
@@ -0,0 +1,249 @@
+#ifndef NOTECACHE_HPP
+#define NOTECACHE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#include "Denormals.hpp"
+#include "EventLog.hpp"
+#include "Excitation.hpp"
+#include "GuitarStringBank.hpp"
+
+// Strings rendered ahead of time, for scores that play the same notes over
+// and over. A string's output depends only on its period, its excitation
+// and its loss. A note whose excitation window comes from seed(frequency)
+// rather than the voice's generator sounds the same every time, so it can
+// be rendered once and replayed with a copy (see StringTake).
+//
+// request() asks for a note ahead of the playhead. A background thread
+// renders it into one of a fixed pool of buffers, evicting the least
+// recently used take no bank is playing. take() hands out a ready take
+// without locking or allocating. A note not ready yet is simply simulated,
+// and sounds the same. A take holds up to maxFrames of the string; a string
+// that rings longer is simulated on from there.
+class NoteCache {
+public:
+    ~NoteCache(){
+        stop();
+    }
+
+    // Allocates `entries` takes of up to maxFrames each and starts the
+    // render thread; 0 entries disables the cache. Call before audio
+    // starts.
+    void prepare(int entries, int maxFrames, double sampleRate,
+                 float silenceThreshold = 1e-4f){
+        stop();
+        numEntries = std::max(0, entries);
+        this->maxFrames = std::max(1, maxFrames);
+        rate = sampleRate;
+        this->silenceThreshold = silenceThreshold;
+        this->entries.reset(numEntries > 0 ? new Entry[numEntries] : nullptr);
+        // a take can overrun maxFrames by a period, plus its closing period
+        for(int i = 0; i < numEntries; i++){
+            this->entries[i].samples.reset(
+                new float[this->maxFrames + 2 * GuitarStringBank::slotLength(rate)]());
+        }
+        if(numEntries > 0){
+            ExcitationBank::shared();
+            quit.store(false, std::memory_order_relaxed);
+            worker = std::thread([this]{ renderLoop(); });
+        }
+    }
+
+    bool enabled() const {
+        return numEntries > 0;
+    }
+
+    // Excitation window for a note at frequency, the same every time.
+    static uint32_t seed(float frequency){
+        uint32_t bits;
+        std::memcpy(&bits, &frequency, sizeof(bits));
+        return (bits * 0x9E3779B9u) ^ (bits >> 15);
+    }
+
+    // Asks for the note to be rendered. Call from one thread at a time;
+    // requests are dropped while the queue is full.
+    void request(float frequency, int excitation){
+        Request r;
+        r.frequency = frequency;
+        r.excitation = excitation;
+        requests.push(r);
+    }
+
+    // Gets the take for a note, if it is ready, and pins it. Any thread.
+    bool take(float frequency, int excitation, StringTake &out){
+        uint64_t t = tag(frequency, excitation);
+        for(int i = 0; i < numEntries; i++){
+            Entry &e = entries[i];
+            if(e.tag.load(std::memory_order_acquire) != t){
+                continue;
+            }
+            // pin first, then check the entry was not evicted meanwhile
+            e.users.fetch_add(1);
+            if(e.tag.load() != t){
+                e.users.fetch_sub(1);
+                continue;
+            }
+            e.lastUsed.store(clock.fetch_add(1, std::memory_order_relaxed),
+                             std::memory_order_relaxed);
+            out.samples = e.samples.get();
+            out.length = e.length;
+            out.pin = &e.users;
+            numHits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        numMisses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    uint64_t hits() const {
+        return numHits.load(std::memory_order_relaxed);
+    }
+    uint64_t misses() const {
+        return numMisses.load(std::memory_order_relaxed);
+    }
+    uint64_t rendered() const {
+        return numRendered.load(std::memory_order_relaxed);
+    }
+
+private:
+    void stop(){
+        if(worker.joinable()){
+            quit.store(true, std::memory_order_release);
+            worker.join();
+        }
+    }
+
+    // The period, excitation type and window of a note packed into one
+    // word, so readers compare it with a single atomic load. Never 0.
+    uint64_t tag(float frequency, int excitation) const {
+        ExcitationBank::Type type = (ExcitationBank::Type)excitation;
+        uint32_t window = isShape(type) ? 0 : seed(frequency) % windows;
+        return (uint64_t)window << 32 | (uint64_t)excitation << 16
+             | (uint64_t)GuitarStringBank::period(frequency, rate);
+    }
+    static bool isShape(ExcitationBank::Type type){
+        return type == ExcitationBank::PickNearBridge || type == ExcitationBank::PickCenter;
+    }
+    static const uint32_t windows = ExcitationBank::noiseLength - ExcitationBank::maxPeriod;
+
+    struct Request {
+        float frequency;
+        int excitation;
+    };
+
+    struct Entry {
+        std::atomic<uint64_t> tag{0};        // 0: empty or being rendered
+        std::atomic<int> users{0};           // banks playing the take
+        std::atomic<uint64_t> lastUsed{0};
+        int length = 0;
+        std::unique_ptr<float[]> samples;
+    };
+
+    void renderLoop(){
+        flushDenormalsOnThisThread();   // same arithmetic as the audio thread
+        Request r;
+        while(!quit.load(std::memory_order_acquire)){
+            if(!requests.pop(r)){
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                continue;
+            }
+            uint64_t t = tag(r.frequency, r.excitation);
+            if(cached(t)){
+                continue;
+            }
+            Entry *e = evict();
+            if(!e){
+                continue;   // every take is playing; the note is simulated
+            }
+            render(r, *e);
+            e->lastUsed.store(clock.fetch_add(1, std::memory_order_relaxed),
+                              std::memory_order_relaxed);
+            e->tag.store(t, std::memory_order_release);
+            numRendered.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    bool cached(uint64_t t) const {
+        for(int i = 0; i < numEntries; i++){
+            if(entries[i].tag.load(std::memory_order_relaxed) == t){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // An empty entry, or else the least recently used one no bank is
+    // playing, unpublished so no new reader can pin it. Null if none.
+    Entry *evict(){
+        for(int i = 0; i < numEntries; i++){
+            if(entries[i].tag.load(std::memory_order_relaxed) == 0){
+                return &entries[i];
+            }
+        }
+        while(true){
+            Entry *oldest = nullptr;
+            for(int i = 0; i < numEntries; i++){
+                Entry &e = entries[i];
+                if(e.users.load(std::memory_order_relaxed) == 0
+                   && (!oldest || e.lastUsed.load(std::memory_order_relaxed)
+                                  < oldest->lastUsed.load(std::memory_order_relaxed))){
+                    oldest = &e;
+                }
+            }
+            if(!oldest){
+                return nullptr;
+            }
+            uint64_t t = oldest->tag.exchange(0);
+            if(oldest->users.load() == 0){
+                return oldest;
+            }
+            oldest->tag.store(t);   // pinned in the meantime; put it back
+        }
+    }
+
+    // Plays the string one period at a time until the next period is all
+    // under the silence threshold, or maxFrames have passed. The take
+    // ends there, and that last period is kept as its closing line state.
+    void render(const Request &r, Entry &e){
+        float *out = e.samples.get();
+        GuitarStringBank string(1, rate, 0.f);
+        int n = string.period(r.frequency);
+        string.pluck(r.frequency, ExcitationBank::shared().get(
+            (ExcitationBank::Type)r.excitation, seed(r.frequency)));
+        int length = 0;
+        while(true){
+            std::fill(out + length, out + length + n, 0.f);
+            string.process(out + length, n);
+            float peak = 0;
+            for(int i = 0; i < n; i++){
+                peak = std::max(peak, std::abs(out[length + i]));
+            }
+            if(peak < silenceThreshold || length >= maxFrames){
+                break;
+            }
+            length += n;
+        }
+        e.length = length;
+    }
+
+    int numEntries = 0;
+    int maxFrames = 1;
+    double rate = 44100;
+    float silenceThreshold = 1e-4f;
+    std::unique_ptr<Entry[]> entries;
+    SpscRing<Request, 1024> requests;
+    std::atomic<uint64_t> clock{1};
+    std::atomic<uint64_t> numHits{0};
+    std::atomic<uint64_t> numMisses{0};
+    std::atomic<uint64_t> numRendered{0};
+    std::atomic<bool> quit{false};
+    std::thread worker;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef OFFLINERENDER_HPP
+#define OFFLINERENDER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "al/io/al_AudioIOData.hpp"
+
+// Drives an audio callback without an audio device, block after block as
+// fast as the CPU allows, and streams the result to disk. Files ending in
+// ".raw" get headerless interleaved float32, anything else a float32 WAV.
+class OfflineRenderer {
+public:
+    struct Stats {
+        double audioSeconds = 0;
+        double wallSeconds = 0;
+        double realtimeFactor() const {
+            return wallSeconds > 0 ? audioSeconds / wallSeconds : 0;
+        }
+    };
+
+    OfflineRenderer(double sampleRate, int blockSize, int channels)
+        : sampleRate(sampleRate), blockSize(blockSize), channels(channels) {
+        io.framesPerSecond(sampleRate);
+        io.framesPerBuffer(blockSize);
+        io.channelsOut(channels);
+        interleaved.resize((size_t)blockSize * channels);
+    }
+
+    // Calls onSound(io) until `seconds` of audio have been produced.
+    // Returns false if the output file could not be written.
+    template <typename Callback>
+    bool render(Callback &&onSound, double seconds, const std::string &path,
+                Stats &stats){
+        FILE * file = fopen(path.c_str(), "wb");
+        if(!file){
+            return false;
+        }
+        bool wav = path.size() < 4 || path.compare(path.size() - 4, 4, ".raw") != 0;
+        if(wav){
+            writeWavHeader(file, 0);
+        }
+
+        uint64_t totalFrames = (uint64_t)(seconds * sampleRate);
+        uint64_t framesDone = 0;
+        auto start = std::chrono::steady_clock::now();
+        while(framesDone < totalFrames){
+            io.zeroOut();
+            io.frame(0);
+            onSound(io);
+
+            int frames = (int)std::min<uint64_t>(blockSize, totalFrames - framesDone);
+            for(int c = 0; c < channels; c++){
+                const float * src = io.outBuffer(c);
+                for(int i = 0; i < frames; i++){
+                    interleaved[(size_t)i * channels + c] = src[i];
+                }
+            }
+            fwrite(interleaved.data(), sizeof(float), (size_t)frames * channels, file);
+            framesDone += frames;
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        if(wav){
+            fseek(file, 0, SEEK_SET);
+            writeWavHeader(file, framesDone);
+        }
+        bool ok = !ferror(file);
+        fclose(file);
+
+        stats.audioSeconds = framesDone / sampleRate;
+        stats.wallSeconds = std::chrono::duration<double>(end - start).count();
+        return ok;
+    }
+
+private:
+    // Float formats need the extended fmt chunk (cbSize, here 0) and a
+    // fact chunk with the frame count, which strict readers insist on.
+    void writeWavHeader(FILE * file, uint64_t frames){
+        uint32_t dataBytes = (uint32_t)(frames * channels * sizeof(float));
+        uint32_t rate = (uint32_t)sampleRate;
+        uint16_t numChannels = (uint16_t)channels;
+        uint16_t blockAlign = (uint16_t)(channels * sizeof(float));
+        uint32_t byteRate = rate * blockAlign;
+        uint32_t fmtSize = 18;
+        uint32_t factSize = 4;
+        uint32_t riffSize = 4 + (8 + fmtSize) + (8 + factSize) + 8 + dataBytes;
+        uint16_t formatFloat = 3;
+        uint16_t bits = 32;
+        uint16_t extraSize = 0;
+
+        fwrite("RIFF", 1, 4, file);
+        writeLE(file, riffSize);
+        fwrite("WAVEfmt ", 1, 8, file);
+        writeLE(file, fmtSize);
+        writeLE(file, formatFloat);
+        writeLE(file, numChannels);
+        writeLE(file, rate);
+        writeLE(file, byteRate);
+        writeLE(file, blockAlign);
+        writeLE(file, bits);
+        writeLE(file, extraSize);
+        fwrite("fact", 1, 4, file);
+        writeLE(file, factSize);
+        writeLE(file, (uint32_t)frames);
+        fwrite("data", 1, 4, file);
+        writeLE(file, dataBytes);
+    }
+    template <typename T>
+    static void writeLE(FILE * file, T value){
+        unsigned char bytes[sizeof(T)];
+        for(size_t i = 0; i < sizeof(T); i++){
+            bytes[i] = (unsigned char)(value >> (8 * i));
+        }
+        fwrite(bytes, 1, sizeof(T), file);
+    }
+
+    double sampleRate;
+    int blockSize;
+    int channels;
+    al::AudioIOData io;
+    std::vector<float> interleaved;
+};
+
+#endif
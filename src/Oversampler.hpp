@@ -0,0 +1,201 @@
+#ifndef OVERSAMPLER_HPP
+#define OVERSAMPLER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "DspKernels.hpp"
+
+// Half-band lowpass for one 2x step, split into its two polyphase
+// branches. Every second tap of a half-band filter is zero except the
+// center one (0.5). One branch is therefore a plain delay, and only the
+// other, `taps` long, is filtered. Coefficients are a Kaiser-windowed
+// sinc.
+class HalfBand {
+public:
+    // taps: length of the filtered branch (even); beta: Kaiser window
+    // shape, higher for more stopband attenuation and a wider transition
+    HalfBand(int taps, double beta) : branch(std::max(2, taps & ~1)) {
+        // prototype of 2 * taps - 1 taps; the branch is its taps at odd
+        // offsets from the center
+        double sum = 0;
+        for(int j = 0; j < branch; j++){
+            int offset = 2 * j - (branch - 1);
+            double h = 0.5 * sinc(offset / 2.0) * kaiser(offset, branch, beta);
+            coeffs.push_back((float)h);
+            sum += h;
+        }
+        // the branch alone has a DC gain of one half
+        for(auto &c : coeffs){
+            c = (float)(c * 0.5 / sum);
+        }
+    }
+
+    int taps() const {
+        return branch;
+    }
+    // delay of the plain branch, in samples of the lower rate
+    int delay() const {
+        return branch / 2;
+    }
+    const float *coefficients() const {
+        return coeffs.data();
+    }
+
+private:
+    static double sinc(double x){
+        const double pi = 3.141592653589793;
+        return x == 0 ? 1.0 : std::sin(pi * x) / (pi * x);
+    }
+    static double besselI0(double x){
+        double sum = 1, term = 1;
+        for(int k = 1; k < 50; k++){
+            term *= (x / (2 * k)) * (x / (2 * k));
+            sum += term;
+            if(term < 1e-12 * sum){
+                break;
+            }
+        }
+        return sum;
+    }
+    // window at `offset` from the center, reaching zero at +/-halfWidth
+    static double kaiser(double offset, double halfWidth, double beta){
+        double r = offset / halfWidth;
+        return besselI0(beta * std::sqrt(std::max(0.0, 1 - r * r))) / besselI0(beta);
+    }
+
+    int branch;
+    std::vector<float> coeffs;
+};
+
+// Raises a block of one channel to 2x, 4x or 8x its sample rate and brings
+// it back down, through cascaded polyphase half-band stages. The stage
+// next to the base rate has to remove everything above the audio band, so
+// it has the long filter. The outer stages only have to reject what would
+// fold back into the audio band, so they are short. Only the filtered
+// branch of each stage does any multiplies, and it goes through the
+// firBlock kernel.
+//
+// Usage per block: float *hi = up(in, n); process hi[0..n * factor());
+// down(out, n). Nothing allocates after prepare().
+class Oversampler {
+public:
+    // factor 1, 2, 4 or 8; maxFrames at the base rate
+    void prepare(int factor, int maxFrames){
+        numStages = factor >= 8 ? 3 : factor >= 4 ? 2 : factor >= 2 ? 1 : 0;
+        capacity = maxFrames;
+        stages.clear();
+        for(int s = 0; s < numStages; s++){
+            // ~90 dB at the base rate, ~70 dB outside it
+            stages.emplace_back(s == 0 ? HalfBand(48, 8.0) : HalfBand(s == 1 ? 12 : 8, 7.0), maxFrames << s);
+        }
+        work[0].assign((size_t)maxFrames << numStages, 0.f);
+        work[1].assign((size_t)maxFrames << numStages, 0.f);
+    }
+
+    void reset(){
+        for(auto &s : stages){
+            s.reset();
+        }
+    }
+
+    int factor() const {
+        return 1 << numStages;
+    }
+    int maxFrames() const {
+        return capacity;
+    }
+    // Returns n * factor() samples at the high rate, valid until the next
+    // call. n must not exceed maxFrames.
+    float *up(const float *in, int n){
+        if(numStages == 0){
+            std::copy(in, in + n, work[0].begin());
+            return work[0].data();
+        }
+        const float *src = in;
+        float *dst = nullptr;
+        for(int s = 0; s < numStages; s++){
+            dst = work[s & 1].data();
+            stages[s].up(src, n << s, dst);
+            src = dst;
+        }
+        return dst;
+    }
+
+    // Filters n * factor() high-rate samples, as returned by up(), back
+    // down to n samples in out.
+    void down(float *out, int n){
+        if(numStages == 0){
+            std::copy(work[0].begin(), work[0].begin() + n, out);
+            return;
+        }
+        const float *src = work[(numStages - 1) & 1].data();
+        for(int s = numStages - 1; s >= 0; s--){
+            float *dst = s == 0 ? out : work[s & 1 ? 0 : 1].data();
+            stages[s].down(src, n << (s + 1), dst);
+            src = dst;
+        }
+    }
+
+private:
+    // one 2x step in each direction, with its own history
+    struct Stage {
+        Stage(HalfBand f, int maxFrames)
+            : filter(std::move(f)),
+              upHistory(filter.taps() - 1 + maxFrames, 0.f),
+              evenHistory(filter.taps() - 1 + maxFrames, 0.f),
+              oddHistory(filter.taps() - 1 + maxFrames, 0.f),
+              branch(maxFrames, 0.f) {}
+
+        void reset(){
+            std::fill(upHistory.begin(), upHistory.end(), 0.f);
+            std::fill(evenHistory.begin(), evenHistory.end(), 0.f);
+            std::fill(oddHistory.begin(), oddHistory.end(), 0.f);
+        }
+
+        // n samples in, 2n out: even outputs filtered, odd ones delayed
+        void up(const float *in, int n, float *out){
+            const int t = filter.taps();
+            std::copy(in, in + n, upHistory.begin() + (t - 1));
+            dspKernels().firBlock(branch.data(), upHistory.data(), filter.coefficients(), t, n);
+            const float *delayed = upHistory.data() + filter.delay();
+            for(int i = 0; i < n; i++){
+                out[2 * i] = 2.f * branch[i];
+                out[2 * i + 1] = delayed[i];
+            }
+            std::copy(upHistory.begin() + n, upHistory.begin() + n + (t - 1), upHistory.begin());
+        }
+
+        // 2n samples in, n out: even inputs filtered, odd ones delayed by
+        // half a sample more, each branch at half gain
+        void down(const float *in, int n2, float *out){
+            const int t = filter.taps();
+            const int n = n2 / 2;
+            for(int i = 0; i < n; i++){
+                evenHistory[t - 1 + i] = in[2 * i];
+                oddHistory[t - 1 + i] = in[2 * i + 1];
+            }
+            dspKernels().firBlock(out, evenHistory.data(), filter.coefficients(), t, n);
+            const float *delayed = oddHistory.data() + filter.delay() - 1;
+            for(int i = 0; i < n; i++){
+                out[i] += 0.5f * delayed[i];
+            }
+            std::copy(evenHistory.begin() + n, evenHistory.begin() + n + (t - 1), evenHistory.begin());
+            std::copy(oddHistory.begin() + n, oddHistory.begin() + n + (t - 1), oddHistory.begin());
+        }
+
+        HalfBand filter;
+        std::vector<float> upHistory;     // taps - 1 previous inputs, then the block
+        std::vector<float> evenHistory;
+        std::vector<float> oddHistory;
+        std::vector<float> branch;
+    };
+
+    std::vector<Stage> stages;
+    std::vector<float> work[2];   // ping-pong buffers at the high rate
+    int numStages = 0;
+    int capacity = 0;
+};
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef PARALLELRENDERER_HPP
+#define PARALLELRENDERER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Denormals.hpp"
+#include "EventLog.hpp"
+#include "RtCheck.hpp"
+
+// Runs the work of each audio block on a persistent pool of worker threads.
+// The work comes in stages, each a fixed number of independent tasks, and
+// every task of a stage finishes before the next stage starts. A task
+// writes only its own outputs, so the result does not depend on which
+// thread ran it. With one thread the same tasks run in the same stages on
+// the calling thread, and the result is the same too.
+//
+// A stage's tasks are dealt round-robin to per-worker queues, and a worker
+// whose queue is empty steals from the others. The audio thread works as
+// worker 0. The other workers are pinned to their own cores. Between
+// stages they spin, so they pick up the next one without a syscall. After
+// spinLimit pauses with nothing to do, in practice between blocks, they
+// sleep on a futex, and render() wakes them when it has work. Elsewhere
+// than Linux they poll with short sleeps instead.
+class ParallelRenderer {
+public:
+    // task(index, frames)
+    typedef std::function<void(int, int)> Task;
+    struct Stage {
+        int tasks;
+        Task run;
+    };
+
+    static const int spinLimit = 4096;
+
+    // threads counts the calling (audio) thread
+    ParallelRenderer(const std::vector<Stage> &stages, int threads)
+        : numWorkers(std::max(1, threads)),
+          numStages((int)stages.size()),
+          work(new Work[numStages]) {
+        for(int s = 0; s < numStages; s++){
+            Work &k = work[s];
+            k.tasks = stages[s].tasks;
+            k.run = stages[s].run;
+            k.queues.reset(new Queue[numWorkers]);
+            for(int w = 0; w < numWorkers; w++){
+                k.queues[w].first = (int)k.order.size();
+                for(int t = w; t < k.tasks; t += numWorkers){
+                    k.order.push_back(t);
+                }
+                k.queues[w].last = (int)k.order.size();
+                k.queues[w].next.store(k.queues[w].last);
+            }
+        }
+        for(int w = 1; w < numWorkers; w++){
+            workers.emplace_back([this, w]{ workerLoop(w); });
+            pin(workers.back(), w);
+        }
+    }
+
+    ~ParallelRenderer(){
+        quit.store(true);
+        generation.fetch_add(1);
+        wake();
+        for(auto &t : workers){
+            t.join();
+        }
+    }
+
+    int threads() const {
+        return numWorkers;
+    }
+
+    // Runs every stage for a block of `frames`. Allocates nothing.
+    void render(int frames){
+        blockFrames = frames;
+        for(int s = 0; s < numStages; s++){
+            Work &k = work[s];
+            // release: a worker still leaving this stage's last run may
+            // claim from a queue as soon as it is reset, and must see the
+            // new block
+            k.completed.store(0, std::memory_order_relaxed);
+            for(int w = 0; w < numWorkers; w++){
+                k.queues[w].next.store(k.queues[w].first, std::memory_order_release);
+            }
+            running.store(s, std::memory_order_relaxed);
+            generation.fetch_add(1);
+            wake();
+
+            runTasks(s, 0);
+            while(k.completed.load(std::memory_order_acquire) < k.tasks){
+                pause();
+            }
+        }
+    }
+
+private:
+    // padded to a cache line so workers claiming from different queues do
+    // not contend on the same line
+    struct Queue {
+        std::atomic<int> next{0};
+        int first = 0;
+        int last = 0;
+        char pad[64 - sizeof(std::atomic<int>) - 2 * sizeof(int)];
+    };
+
+    struct Work {
+        int tasks = 0;
+        Task run;
+        std::unique_ptr<Queue[]> queues;
+        std::vector<int> order;   // task indices grouped by owning worker
+        std::atomic<int> completed{0};
+    };
+
+    void workerLoop(int w){
+        flushDenormals(true);
+        EventLog::threadRole(w);
+        unsigned seen = generation.load(std::memory_order_acquire);
+        int spins = 0;
+        while(!quit.load(std::memory_order_acquire)){
+            unsigned g = generation.load(std::memory_order_acquire);
+            if(g == seen){
+                if(++spins < spinLimit){
+                    pause();
+                } else {
+                    park(seen);
+                    spins = 0;
+                }
+                continue;
+            }
+            seen = g;
+            spins = 0;
+            if(quit.load()){
+                break;
+            }
+            RT_CHECK_SCOPE();
+            runTasks(running.load(std::memory_order_relaxed), w);
+        }
+    }
+
+    // drains this worker's queue of stage s, then steals from the others
+    void runTasks(int s, int w){
+        Work &k = work[s];
+        for(int j = 0; j < numWorkers; j++){
+            Queue &q = k.queues[(w + j) % numWorkers];
+            for(;;){
+                int i = q.next.fetch_add(1, std::memory_order_acq_rel);
+                if(i >= q.last){
+                    break;
+                }
+                k.run(k.order[i], blockFrames);
+                k.completed.fetch_add(1, std::memory_order_release);
+            }
+        }
+    }
+
+    // Sleeps until the generation moves on from `seen`. A worker counts
+    // itself in sleepers before it checks the generation, and render()
+    // bumps the generation before it checks sleepers, so one of the two
+    // always sees the other and no wakeup is lost.
+    void park(unsigned seen){
+        sleepers.fetch_add(1);
+#if defined(__linux__)
+        static_assert(sizeof(generation) == sizeof(int), "futex needs a 32-bit word");
+        if(generation.load() == seen){
+            syscall(SYS_futex, reinterpret_cast<int *>(&generation), FUTEX_WAIT_PRIVATE,
+                    (int)seen, nullptr, nullptr, 0);
+        }
+#else
+        if(generation.load() == seen){
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+#endif
+        sleepers.fetch_sub(1);
+    }
+
+    // one syscall, and only when some worker is asleep
+    void wake(){
+#if defined(__linux__)
+        if(sleepers.load() > 0){
+            syscall(SYS_futex, reinterpret_cast<int *>(&generation), FUTEX_WAKE_PRIVATE,
+                    INT_MAX, nullptr, nullptr, 0);
+        }
+#endif
+    }
+
+    static void pause(){
+#if defined(__SSE2__)
+        _mm_pause();
+#endif
+    }
+
+    static void pin(std::thread &t, int w){
+#if defined(__linux__)
+        int cores = (int)std::thread::hardware_concurrency();
+        if(cores > 1){
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(w % cores, &set);
+            pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+        }
+#endif
+    }
+
+    int numWorkers;
+    int numStages;
+    std::unique_ptr<Work[]> work;
+    int blockFrames = 0;
+
+    std::vector<std::thread> workers;
+    std::atomic<unsigned> generation{0};   // advanced for each stage run
+    std::atomic<int> running{0};           // the stage it was advanced for
+    std::atomic<int> sleepers{0};
+    std::atomic<bool> quit{false};
+};
+
+#endif
@@ -0,0 +1,207 @@
+// Real-time safety checker; see RtCheck.hpp. Only built into the app with
+// GUITAR_RT_CHECK=ON.
+//
+// The allocator is replaced by forwarding to glibc's __libc_* entry points.
+// The blocking calls forward to the next definition found with
+// dlsym(RTLD_NEXT). That pointer is cached in an atomic rather than a
+// function-local static, whose guard could itself take a mutex. While a
+// hit is being reported the thread is not checked, so the report's own
+// writes and allocations do not recurse.
+
+#include "RtCheck.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *p);
+}
+
+namespace {
+
+thread_local int realtimeDepth = 0;   // > 0 inside an RT_CHECK_SCOPE
+thread_local bool reporting = false;
+
+std::atomic<uint64_t> hits{0};
+
+// hashes of the call stacks already printed
+const int maxSites = 256;
+std::atomic<uint64_t> sites[maxSites];
+
+bool firstSighting(uint64_t hash){
+    for(int i = 0; i < maxSites; i++){
+        uint64_t seen = sites[i].load(std::memory_order_acquire);
+        if(seen == hash){
+            return false;
+        }
+        if(seen == 0 && sites[i].compare_exchange_strong(seen, hash)){
+            return true;
+        }
+        if(seen == hash){
+            return false;
+        }
+    }
+    return false;   // table full: count, but stop printing
+}
+
+void violation(const char *call){
+    if(realtimeDepth == 0 || reporting){
+        return;
+    }
+    reporting = true;
+    hits.fetch_add(1, std::memory_order_relaxed);
+
+    void *frames[32];
+    int depth = backtrace(frames, 32);
+    uint64_t hash = 1469598103934665603ull;
+    for(int i = 1; i < depth; i++){
+        hash = (hash ^ (uint64_t)(uintptr_t)frames[i]) * 1099511628211ull;
+    }
+    if(firstSighting(hash | 1)){
+        char line[96];
+        int n = std::snprintf(line, sizeof(line), "rt-check: %s on a real-time thread\n", call);
+        if(n > 0 && write(2, line, (size_t)n) < 0){
+            n = 0;
+        }
+        backtrace_symbols_fd(frames + 1, depth - 1, 2);
+    }
+
+    const char *abortOn = std::getenv("GUITAR_RT_CHECK_ABORT");
+    if(abortOn && abortOn[0] == '1'){
+        std::abort();
+    }
+    reporting = false;
+}
+
+// the definition of `name` after this one, looked up on first use
+template <typename Fn>
+Fn next(std::atomic<Fn> &cache, const char *name){
+    Fn fn = cache.load(std::memory_order_acquire);
+    if(!fn){
+        fn = (Fn)dlsym(RTLD_NEXT, name);
+        cache.store(fn, std::memory_order_release);
+    }
+    return fn;
+}
+
+}
+
+namespace rtcheck {
+
+Scope::Scope(){
+    realtimeDepth++;
+}
+Scope::~Scope(){
+    realtimeDepth--;
+}
+
+uint64_t violations(){
+    return hits.load(std::memory_order_relaxed);
+}
+
+}
+
+extern "C" {
+
+void *malloc(size_t size){
+    violation("malloc");
+    return __libc_malloc(size);
+}
+void *calloc(size_t count, size_t size){
+    violation("calloc");
+    return __libc_calloc(count, size);
+}
+void *realloc(void *p, size_t size){
+    violation("realloc");
+    return __libc_realloc(p, size);
+}
+void free(void *p){
+    if(p){
+        violation("free");
+    }
+    __libc_free(p);
+}
+void *memalign(size_t alignment, size_t size){
+    violation("memalign");
+    return __libc_memalign(alignment, size);
+}
+void *aligned_alloc(size_t alignment, size_t size){
+    violation("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+int posix_memalign(void **out, size_t alignment, size_t size){
+    violation("posix_memalign");
+    void *p = __libc_memalign(alignment, size);
+    if(!p){
+        return ENOMEM;
+    }
+    *out = p;
+    return 0;
+}
+
+int pthread_mutex_lock(pthread_mutex_t *mutex){
+    typedef int (*Fn)(pthread_mutex_t *);
+    static std::atomic<Fn> real{nullptr};
+    violation("pthread_mutex_lock");
+    return next(real, "pthread_mutex_lock")(mutex);
+}
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex){
+    typedef int (*Fn)(pthread_cond_t *, pthread_mutex_t *);
+    static std::atomic<Fn> real{nullptr};
+    violation("pthread_cond_wait");
+    return next(real, "pthread_cond_wait")(cond, mutex);
+}
+int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                           const struct timespec *until){
+    typedef int (*Fn)(pthread_cond_t *, pthread_mutex_t *, const struct timespec *);
+    static std::atomic<Fn> real{nullptr};
+    violation("pthread_cond_timedwait");
+    return next(real, "pthread_cond_timedwait")(cond, mutex, until);
+}
+int sem_wait(sem_t *sem){
+    typedef int (*Fn)(sem_t *);
+    static std::atomic<Fn> real{nullptr};
+    violation("sem_wait");
+    return next(real, "sem_wait")(sem);
+}
+int nanosleep(const struct timespec *duration, struct timespec *remaining){
+    typedef int (*Fn)(const struct timespec *, struct timespec *);
+    static std::atomic<Fn> real{nullptr};
+    violation("nanosleep");
+    return next(real, "nanosleep")(duration, remaining);
+}
+int usleep(useconds_t usec){
+    typedef int (*Fn)(useconds_t);
+    static std::atomic<Fn> real{nullptr};
+    violation("usleep");
+    return next(real, "usleep")(usec);
+}
+ssize_t read(int fd, void *buf, size_t count){
+    typedef ssize_t (*Fn)(int, void *, size_t);
+    static std::atomic<Fn> real{nullptr};
+    violation("read");
+    return next(real, "read")(fd, buf, count);
+}
+ssize_t write(int fd, const void *buf, size_t count){
+    typedef ssize_t (*Fn)(int, const void *, size_t);
+    static std::atomic<Fn> real{nullptr};
+    violation("write");
+    return next(real, "write")(fd, buf, count);
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef RTCHECK_HPP
+#define RTCHECK_HPP
+
+#include <cstdint>
+
+// Build with -DGUITAR_RT_CHECK=ON (CMake) to link in the real-time safety
+// checker. Threads inside an RT_CHECK_SCOPE() are treated as real-time, and
+// any of these calls made on them is reported:
+//
+//   malloc, calloc, realloc, free and the aligned allocators (and so every
+//   operator new and delete), pthread_mutex_lock, pthread_cond_wait and
+//   timedwait, sem_wait, nanosleep, usleep, read and write.
+//
+// Each distinct call stack is printed to stderr once with a backtrace; all
+// hits are counted. Set GUITAR_RT_CHECK_ABORT=1 to abort on the first one
+// instead, e.g. under a debugger. The checker interposes the C library, so
+// it is for debugging only and needs glibc. Without it the macros compile
+// away.
+#ifndef GUITAR_RT_CHECK
+#define GUITAR_RT_CHECK 0
+#endif
+
+#if GUITAR_RT_CHECK
+namespace rtcheck {
+
+// Marks the calling thread real-time while it exists. Scopes nest.
+class Scope {
+public:
+    Scope();
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+};
+
+// hits since startup, from every thread
+uint64_t violations();
+
+}
+
+#define RT_CHECK_SCOPE() rtcheck::Scope rtCheckScope_
+#define RT_CHECK_VIOLATIONS() rtcheck::violations()
+#else
+#define RT_CHECK_SCOPE() ((void)0)
+#define RT_CHECK_VIOLATIONS() ((uint64_t)0)
+#endif
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef SCORE_HPP
+#define SCORE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+// Binary score: a header, a table of parameter sets, then fixed-size note
+// records sorted by start time. All fields are little-endian. A note names
+// its parameter set by index, so a record stays 24 bytes however many
+// parameters a voice has.
+//
+//   ScoreHeader
+//   ScoreParams[paramSets]
+//   ScoreRecord[notes]
+
+struct ScoreHeader {
+    char magic[8];        // "GTRSCORE"
+    uint32_t version;     // 1
+    uint32_t paramSets;
+    uint64_t notes;
+};
+
+// trigger parameters a note sets on its voice
+struct ScoreParams {
+    float pan;            // -1..1
+    float excitation;     // ExcitationBank::Type
+    float releaseTime;    // seconds
+    float reserved;
+};
+
+struct ScoreRecord {
+    double start;         // seconds from the beginning of the score
+    float duration;       // seconds
+    float frequency;      // Hz
+    uint16_t track;
+    uint16_t paramSet;    // index into the ScoreParams table
+    uint32_t reserved;
+};
+
+static_assert(sizeof(ScoreHeader) == 24, "ScoreHeader layout");
+static_assert(sizeof(ScoreParams) == 16, "ScoreParams layout");
+static_assert(sizeof(ScoreRecord) == 24, "ScoreRecord layout");
+
+// A score file opened for playback. Nothing is read up front beyond the
+// header: records are paged in from the mapping as the scheduler reaches
+// them, so opening an hour-long score is instant and costs no memory
+// until it plays.
+class ScoreFile {
+public:
+    explicit ScoreFile(const std::string &path) : file(path) {
+        const uint8_t *p = file.data();
+        if(!p || file.size() < sizeof(ScoreHeader)){
+            return;
+        }
+        ScoreHeader h;
+        std::memcpy(&h, p, sizeof(h));
+        if(std::memcmp(h.magic, "GTRSCORE", 8) != 0 || h.version != 1 || h.paramSets == 0){
+            return;
+        }
+        size_t paramBytes = (size_t)h.paramSets * sizeof(ScoreParams);
+        size_t available = file.size() - sizeof(ScoreHeader);
+        if(paramBytes > available){
+            return;
+        }
+        uint64_t fit = (available - paramBytes) / sizeof(ScoreRecord);
+        numParams = h.paramSets;
+        numNotes = (size_t)std::min<uint64_t>(h.notes, fit);
+        paramTable = (const ScoreParams *)(p + sizeof(ScoreHeader));
+        recordTable = (const ScoreRecord *)(p + sizeof(ScoreHeader) + paramBytes);
+    }
+
+    bool valid() const {
+        return paramTable != nullptr;
+    }
+    // Notes are trusted no more than the file they come from. A record is
+    // playable when its start and duration are finite, not negative and
+    // under maxSeconds, and its frequency finite and positive. Players
+    // skip the others.
+    static constexpr double maxSeconds = 1e7;
+    static bool playable(const ScoreRecord &r){
+        return r.start >= 0 && r.start < maxSeconds
+            && r.duration >= 0 && r.duration < maxSeconds
+            && r.frequency > 0 && std::isfinite(r.frequency);
+    }
+    size_t size() const {
+        return numNotes;
+    }
+    const ScoreRecord &record(size_t i) const {
+        return recordTable[i];
+    }
+    // the note's parameter set, or the first one if its index is out of range
+    const ScoreParams &params(const ScoreRecord &r) const {
+        return paramTable[r.paramSet < numParams ? r.paramSet : 0];
+    }
+    // End of the latest-ending playable note, used as the default render
+    // length. It reads every record, so call it once, off the audio thread.
+    double duration() const {
+        double end = 0;
+        for(size_t i = 0; i < numNotes; i++){
+            if(playable(recordTable[i])){
+                end = std::max(end, recordTable[i].start + recordTable[i].duration);
+            }
+        }
+        return end;
+    }
+
+    // starts paging in records [first, first + count) in the background
+    void prefetch(size_t first, size_t count) const {
+        if(!valid() || first >= numNotes){
+            return;
+        }
+        size_t offset = (const uint8_t *)(recordTable + first) - file.data();
+        file.willNeed(offset, count * sizeof(ScoreRecord));
+    }
+
+private:
+    MappedFile file;
+    const ScoreParams *paramTable = nullptr;
+    const ScoreRecord *recordTable = nullptr;
+    size_t numParams = 0;
+    size_t numNotes = 0;
+};
+
+// Writes a score file one note at a time, so a generator never holds the
+// whole piece in memory. Notes must be added in start order.
+class ScoreWriter {
+public:
+    ScoreWriter(const std::string &path, const std::vector<ScoreParams> &params)
+        : file(std::fopen(path.c_str(), "wb"), &std::fclose) {
+        if(!file || params.empty()){
+            ok = false;
+            return;
+        }
+        numParams = (uint32_t)params.size();
+        writeHeader();
+        std::fwrite(params.data(), sizeof(ScoreParams), params.size(), file.get());
+    }
+
+    // false if the note starts before the previous one
+    bool add(double start, float duration, float frequency, int track, int paramSet = 0){
+        if(!ok || start < lastStart){
+            return false;
+        }
+        ScoreRecord r = {};
+        r.start = start;
+        r.duration = duration;
+        r.frequency = frequency;
+        r.track = (uint16_t)track;
+        r.paramSet = (uint16_t)paramSet;
+        ok = std::fwrite(&r, sizeof(r), 1, file.get()) == 1;
+        lastStart = start;
+        numNotes++;
+        return ok;
+    }
+
+    // patches the note count into the header; returns false on any error
+    bool close(){
+        if(!file){
+            return false;
+        }
+        ok = ok && std::fseek(file.get(), 0, SEEK_SET) == 0;
+        if(ok){
+            writeHeader();
+        }
+        ok = ok && !std::ferror(file.get());
+        return std::fclose(file.release()) == 0 && ok;
+    }
+
+private:
+    void writeHeader(){
+        ScoreHeader h;
+        std::memcpy(h.magic, "GTRSCORE", 8);
+        h.version = 1;
+        h.paramSets = numParams;
+        h.notes = numNotes;
+        std::fwrite(&h, sizeof(h), 1, file.get());
+    }
+
+    std::unique_ptr<FILE, int (*)(FILE *)> file;
+    uint32_t numParams = 0;
+    uint64_t numNotes = 0;
+    double lastStart = 0;
+    bool ok = true;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef SINEENV_HPP
+#define SINEENV_HPP
+
+#include "Gamma/Effects.h"
+#include "Gamma/Envelope.h"
+#include "al/scene/al_PolySynth.hpp"
+
+#include "AdditiveOsc.hpp"
+#include "VoiceParams.hpp"
+
+class SineEnv : public al::SynthVoice
+{
+public:
+    // Unit generators
+    gam::Pan<> mPan;
+    WavetableOsc mOsc;   // six harmonics at 1/n, band-limited per note
+    gam::Env<3> mAmpEnv;
+
+    // Parameter handles, resolved in init() and read once per block
+    SmoothedParam mAmplitude;
+    VoiceParam mFrequency;
+    VoiceParam mAttackTime;
+    VoiceParam mReleaseTime;
+    VoiceParam mPanPos;
+    void init() override
+    {
+        // Intialize envelope
+        mAmpEnv.curve(0); // make segments lines
+        mAmpEnv.levels(0, 1, 1, 0);
+        mAmpEnv.sustainPoint(2); // Make point 2 sustain until a release is issued
+
+        mOsc.source(&harmonicTable());
+
+        mAmplitude.bind(createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0));
+        mFrequency.bind(createInternalTriggerParameter("frequency", 60, 20, 5000));
+        mAttackTime.bind(createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0));
+        mReleaseTime.bind(createInternalTriggerParameter("releaseTime", 0.1, 0.1, 10.0));
+        mPanPos.bind(createInternalTriggerParameter("pan", 0.0, -1.0, 1.0));
+    }
+
+    // The audio processing function
+    void onProcess(al::AudioIOData &io) override
+    {
+        int frames = io.framesPerBuffer() - (io.frame() + 1);
+        mAmplitude.snapshot(frames);
+
+        float f = mFrequency.snapshot();
+        mOsc.freq(f, io.framesPerSecond());
+
+        mAmpEnv.lengths()[0] = mAttackTime.snapshot();
+        mAmpEnv.lengths()[2] = mReleaseTime.snapshot();
+        mPan.pos(mPanPos.snapshot());
+        while (io())
+        {
+            float s1 = mOsc() * mAmpEnv() * mAmplitude.next();
+            float s2;
+            mPan(s1, s1, s2);
+            io.out(0) += s1;
+            io.out(1) += s2;
+        }
+        if (mAmpEnv.done())
+            free();
+    }
+
+    void onTriggerOn() override {
+        mAmpEnv.reset();
+        mAmplitude.reset();
+        mOsc.reset();
+    }
+
+    void onTriggerOff() override { mAmpEnv.release(); }
+
+    // shared by all SineEnv voices, built by the first init()
+    static const AdditiveTable &harmonicTable() {
+        static const AdditiveTable table({1.f, 1.f/2, 1.f/3, 1.f/4, 1.f/5, 1.f/6});
+        return table;
+    }
+};
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef SPATIALIZER_HPP
+#define SPATIALIZER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "al/io/al_AudioIOData.hpp"
+
+#include "DspKernels.hpp"
+
+// Loudspeaker positions, as azimuths in degrees clockwise from the front.
+// Speakers on a ring surround the listener. Otherwise they span an arc,
+// and sources outside it play from the nearest end.
+struct SpeakerLayout {
+    std::vector<float> azimuths;   // by output channel
+    bool ring = false;
+
+    static SpeakerLayout stereo(){
+        SpeakerLayout l;
+        l.azimuths = {-30.f, 30.f};
+        return l;
+    }
+    // n speakers evenly spaced, channel 0 in front
+    static SpeakerLayout circle(int n){
+        SpeakerLayout l;
+        for(int k = 0; k < n; k++){
+            l.azimuths.push_back(wrap(360.f * k / n));
+        }
+        l.ring = n >= 3;
+        return l;
+    }
+    // mono, stereo, or a ring for more channels
+    static SpeakerLayout forChannels(int n){
+        return n == 2 ? stereo() : circle(std::max(1, n));
+    }
+
+    int channels() const {
+        return (int)azimuths.size();
+    }
+
+    // to (-180, 180]
+    static float wrap(float degrees){
+        degrees = std::fmod(degrees, 360.f);
+        if(degrees > 180.f){
+            degrees -= 360.f;
+        } else if(degrees <= -180.f){
+            degrees += 360.f;
+        }
+        return degrees;
+    }
+};
+
+// Maps a few mono source channels to the speakers of a layout through a
+// gain matrix. A source's gains come from pairwise amplitude panning
+// (VBAP): only the two speakers either side of it get signal, with
+// constant power. Gains are recomputed only when a source moves, and
+// ramped over the next block to avoid zipper noise. Mixing is one
+// vectorized multiply-add per non-zero matrix entry, so each source costs
+// at most two speakers whatever the layout.
+//
+// position() may be called from any thread; mix() from the audio thread.
+class Spatializer {
+public:
+    // Call before audio starts.
+    void prepare(const SpeakerLayout &layout, int sources){
+        speakers = layout;
+        numSources = std::max(1, sources);
+        int outs = speakers.channels();
+        order.resize(outs);
+        for(int k = 0; k < outs; k++){
+            order[k] = k;
+        }
+        std::sort(order.begin(), order.end(), [this](int a, int b){
+            return speakers.azimuths[a] < speakers.azimuths[b];
+        });
+        current.assign((size_t)numSources * outs, 0.f);
+        target.assign((size_t)numSources * outs, 0.f);
+        azimuths.reset(new std::atomic<float>[numSources]);
+        for(int s = 0; s < numSources; s++){
+            azimuths[s].store(0.f, std::memory_order_relaxed);
+        }
+        changed.store(1, std::memory_order_relaxed);
+        seen = 0;
+        first = true;
+    }
+
+    int sources() const {
+        return numSources;
+    }
+    const SpeakerLayout &layout() const {
+        return speakers;
+    }
+
+    void position(int source, float azimuth){
+        if(source < 0 || source >= numSources){
+            return;
+        }
+        azimuths[source].store(SpeakerLayout::wrap(azimuth), std::memory_order_relaxed);
+        changed.fetch_add(1, std::memory_order_release);
+    }
+
+    // Adds sources in[0..sources) to the output channels of io.
+    void mix(const float *const *in, al::AudioIOData &io, int frames){
+        unsigned c = changed.load(std::memory_order_acquire);
+        bool ramp = false;
+        if(c != seen){
+            seen = c;
+            for(int s = 0; s < numSources; s++){
+                pan(azimuths[s].load(std::memory_order_relaxed), &target[(size_t)s * outputs()]);
+            }
+            // a first mix jumps straight to the gains
+            ramp = !first;
+            if(!ramp){
+                current = target;
+            }
+        }
+        first = false;
+
+        const DspKernels &kernels = dspKernels();
+        int outs = std::min(outputs(), (int)io.channelsOut());
+        float perFrame = frames > 0 ? 1.f / frames : 0.f;
+        for(int s = 0; s < numSources; s++){
+            float *g = &current[(size_t)s * outputs()];
+            const float *t = &target[(size_t)s * outputs()];
+            for(int o = 0; o < outs; o++){
+                float step = ramp ? (t[o] - g[o]) * perFrame : 0.f;
+                if(g[o] != 0.f || step != 0.f){
+                    kernels.mixGain(io.outBuffer(o), in[s], g[o], step, frames);
+                }
+                g[o] = t[o];
+            }
+        }
+    }
+
+private:
+    int outputs() const {
+        return speakers.channels();
+    }
+
+    // VBAP gains of one source into gains[outputs()]
+    void pan(float azimuth, float *gains) const {
+        int n = outputs();
+        std::fill(gains, gains + n, 0.f);
+        if(n == 1){
+            gains[0] = 1.f;
+            return;
+        }
+        const std::vector<float> &az = speakers.azimuths;
+        if(!speakers.ring){
+            if(azimuth <= az[order.front()]){
+                gains[order.front()] = 1.f;
+                return;
+            }
+            if(azimuth >= az[order.back()]){
+                gains[order.back()] = 1.f;
+                return;
+            }
+        }
+        // the adjacent pair whose arc holds the source
+        int pairs = speakers.ring ? n : n - 1;
+        for(int k = 0; k < pairs; k++){
+            int a = order[k];
+            int b = order[(k + 1) % n];
+            float span = SpeakerLayout::wrap(az[b] - az[a]);
+            float into = SpeakerLayout::wrap(azimuth - az[a]);
+            if(span <= 0.f){
+                span += 360.f;
+            }
+            if(into < 0.f){
+                into += 360.f;
+            }
+            if(into <= span){
+                pairGains(azimuth, az[a], az[b], gains[a], gains[b]);
+                return;
+            }
+        }
+    }
+
+    // solves g1 * l1 + g2 * l2 = p for the unit vectors of the source and
+    // the two speakers, normalized to unit power
+    static void pairGains(float source, float s1, float s2, float &g1, float &g2){
+        const float rad = 3.14159265f / 180.f;
+        float px = std::sin(source * rad), py = std::cos(source * rad);
+        float ax = std::sin(s1 * rad), ay = std::cos(s1 * rad);
+        float bx = std::sin(s2 * rad), by = std::cos(s2 * rad);
+        float det = ax * by - bx * ay;
+        if(std::abs(det) < 1e-6f){
+            g1 = g2 = std::sqrt(0.5f);
+            return;
+        }
+        float a = (px * by - bx * py) / det;
+        float b = (ax * py - px * ay) / det;
+        a = std::max(0.f, a);
+        b = std::max(0.f, b);
+        float norm = std::sqrt(a * a + b * b);
+        g1 = norm > 0 ? a / norm : 0.f;
+        g2 = norm > 0 ? b / norm : 0.f;
+    }
+
+    SpeakerLayout speakers;
+    std::vector<int> order;       // output channels by azimuth
+    int numSources = 0;
+    std::vector<float> current;   // [source][output], gains in use
+    std::vector<float> target;    // where they ramp to
+    std::unique_ptr<std::atomic<float>[]> azimuths;
+    std::atomic<unsigned> changed{0};
+    unsigned seen = 0;            // audio thread only
+    bool first = true;
+};
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef TRACK_HPP
+#define TRACK_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+#include "al/io/al_AudioIOData.hpp"
+
+#include "AmpStage.hpp"
+#include "Convolver.hpp"
+#include "InstrumentGroup.hpp"
+#include "Spatializer.hpp"
+#include "Visualizer.hpp"
+#include "VoicePool.hpp"
+
+// One instrument of the score: the voices it plays and the parameters they
+// share. Tracks render independently of each other. Notes go through the
+// pool, which keeps the track within its polyphony.
+//
+// The voices mix onto a two-channel track bus, the left and right edges of
+// the track's image; a voice's pan places it between them. The bus is
+// convolved with the body impulse response, if there is one, and goes
+// through the amp if it is enabled. Then the spatializer places its two
+// edges among the speakers. Voices, body and amp cost the same whether the
+// output has 2 channels or 64.
+//
+// A block renders in three steps, so the voices can be spread over
+// threads: renderVoices() for each voice task, in any order or at once,
+// then finish(), then mix(). Each voice task renders up to voicesPerTask
+// of the sounding voices into a buffer of its own, and finish() sums the
+// tasks in task order. The result is the same whichever threads ran them.
+struct Track {
+    static const int busChannels = 2;
+    static const int voicesPerTask = 4;
+
+    InstrumentGroup group;
+    VoicePool voices;
+    AmpStage amp;   // bypassed until amp.prepare()
+
+    // Sizes the track bus and the voice tasks' buffers for blocks of up to
+    // maxFrames, sets up the body stage (none when ir is null) and the
+    // speakers to mix to. Call after voices.allocate(), before audio
+    // starts.
+    //
+    // When maxFrames is whole partitions of the IR, the body adds no
+    // latency, and every block must then be whole partitions. Otherwise
+    // blocks may be any size up to maxFrames, and the body output comes one
+    // partition late.
+    void prepare(double sampleRate, int maxFrames, const SpeakerLayout &layout,
+                 std::shared_ptr<const PartitionedIR> ir){
+        bodyIR = std::move(ir);
+        rate = sampleRate;
+        busFrames = maxFrames;
+        numTasks = std::max(1, (voices.capacity() + voicesPerTask - 1) / voicesPerTask);
+        bus.assign((size_t)busChannels * maxFrames, 0.f);
+        taskBus.assign((size_t)numTasks * busChannels * maxFrames, 0.f);
+        body.clear();
+        if(bodyIR){
+            Convolver::Latency latency = Convolver::latencyFor(*bodyIR, maxFrames);
+            body.resize(busChannels);
+            for(auto &c : body){
+                c.prepare(bodyIR, latency);
+            }
+        }
+        spatial.prepare(layout, busChannels);
+        position(0.f);
+    }
+
+    // Centers the track's image at `azimuth` degrees clockwise from the
+    // front, `spread` degrees wide; the default on a stereo pair is the
+    // plain left and right. Any thread may call it after prepare().
+    void position(float azimuth, float spread = 60.f){
+        spatial.position(0, azimuth - spread / 2);
+        spatial.position(1, azimuth + spread / 2);
+    }
+
+    // Sends the track's output to a scope as track `slot`; null stops it.
+    // Call before audio starts.
+    void tap(ScopeFeed *feed, int slot){
+        scope = feed;
+        scopeSlot = slot;
+    }
+
+    int voiceTasks() const {
+        return numTasks;
+    }
+
+    // Renders voice task `task` of the block. Blocks longer than
+    // prepare()'s or amp.prepare()'s maxFrames are a caller error.
+    void renderVoices(int task, int frames){
+        assert(frames <= busFrames);
+        float *edges[busChannels];
+        for(int c = 0; c < busChannels; c++){
+            edges[c] = &taskBus[((size_t)task * busChannels + c) * busFrames];
+            std::fill(edges[c], edges[c] + frames, 0.f);
+        }
+        voices.render(edges[0], edges[1], frames, rate, task, numTasks);
+    }
+
+    // Sums the voice tasks onto the bus and runs it through the body, the
+    // amp and the scope. Call once every voice task of the block is done.
+    void finish(int frames){
+        assert(!amp.enabled() || frames <= amp.maxFrames());
+        voices.reclaim();
+        float *edges[busChannels];
+        busEdges(edges);
+        for(int c = 0; c < busChannels; c++){
+            std::fill(edges[c], edges[c] + frames, 0.f);
+            for(int t = 0; t < numTasks; t++){
+                const float *in = &taskBus[((size_t)t * busChannels + c) * busFrames];
+                for(int i = 0; i < frames; i++){
+                    edges[c][i] += in[i];
+                }
+            }
+            if(bodyIR){
+                body[c].process(edges[c], frames);
+            }
+        }
+        amp.process(edges, busChannels, frames);
+        if(scope){
+            scope->write(scopeSlot, edges[0], edges[1], frames);
+        }
+    }
+
+    // Adds the finished block into the speaker channels of io.
+    void mix(al::AudioIOData &io){
+        float *edges[busChannels];
+        busEdges(edges);
+        spatial.mix(edges, io, io.framesPerBuffer());
+    }
+
+private:
+    void busEdges(float **edges){
+        for(int c = 0; c < busChannels; c++){
+            edges[c] = &bus[(size_t)c * busFrames];
+        }
+    }
+
+    std::shared_ptr<const PartitionedIR> bodyIR;
+    std::vector<Convolver> body;   // one per bus channel
+    std::vector<float> bus;        // busChannels blocks of busFrames
+    std::vector<float> taskBus;    // the same for each voice task
+    int numTasks = 1;
+    int busFrames = 0;
+    double rate = 44100;
+    Spatializer spatial;
+    ScopeFeed *scope = nullptr;
+    int scopeSlot = 0;
+};
+
+#endif
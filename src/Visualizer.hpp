@@ -0,0 +1,235 @@
+#ifndef VISUALIZER_HPP
+#define VISUALIZER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "al/ui/al_Imgui.hpp"
+
+#include "FFT.hpp"
+
+// Hands the latest value of T from one writer thread to one reader thread
+// through three slots. The writer fills back() and publish()es it; the
+// reader calls update() and then reads front(). Both sides only swap slot
+// indices with a single atomic exchange, so neither ever waits for the
+// other. The reader skips values it was too slow to see.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : slots(new T[3]()) {}
+
+    T &back(){
+        return slots[backIndex];
+    }
+    void publish(){
+        backIndex = middle.exchange(backIndex | fresh, std::memory_order_acq_rel) & ~fresh;
+    }
+
+    // Takes the newest published value, if any; returns false when
+    // front() is already the newest.
+    bool update(){
+        if(!(middle.load(std::memory_order_relaxed) & fresh)){
+            return false;
+        }
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & ~fresh;
+        return true;
+    }
+    const T &front() const {
+        return slots[frontIndex];
+    }
+
+private:
+    static const int fresh = 4;   // middle slot holds an unread value
+
+    std::unique_ptr<T[]> slots;
+    std::atomic<int> middle{1};
+    int backIndex = 0;    // writer only
+    int frontIndex = 2;   // reader only
+};
+
+// What the scope shows: the last few thousand samples of every track and
+// the level of every sounding string, as of one audio block.
+struct ScopeSnapshot {
+    static const int maxTracks = 8;
+    static const int samples = 2048;
+    static const int maxStrings = 128;
+
+    int tracks = 0;
+    int strings = 0;
+    double sampleRate = 44100;
+    float wave[maxTracks][samples];   // oldest first
+    float stringLevel[maxStrings];    // line peak, 0..0.5
+};
+
+// Audio-thread side of the visualization. Tracks write() their output each
+// block (from any render thread, each to its own track), strings report
+// their levels, and the audio thread publish()es the lot once the block is
+// done. The history is kept in rings here and copied into the snapshot on
+// publish. Nothing blocks, allocates or waits on the UI.
+class ScopeFeed {
+public:
+    // Call before audio starts.
+    void prepare(int tracks, double sampleRate){
+        numTracks = std::min(tracks, (int)ScopeSnapshot::maxTracks);
+        rate = sampleRate;
+        history.assign((size_t)numTracks * ScopeSnapshot::samples, 0.f);
+        heads.assign(numTracks, 0);
+    }
+
+    int tracks() const {
+        return numTracks;
+    }
+
+    // Appends the mono sum of a track's two channels to its history.
+    void write(int track, const float *left, const float *right, int frames){
+        if(track < 0 || track >= numTracks){
+            return;
+        }
+        float *ring = &history[(size_t)track * ScopeSnapshot::samples];
+        int head = heads[track];
+        for(int i = 0; i < frames; i++){
+            ring[head] = 0.5f * (left[i] + right[i]);
+            head = (head + 1) & (ScopeSnapshot::samples - 1);
+        }
+        heads[track] = head;
+    }
+
+    // Called for each sounding string between publishes.
+    void stringLevel(float level){
+        if(strings < ScopeSnapshot::maxStrings){
+            levels[strings++] = level;
+        }
+    }
+
+    void publish(){
+        ScopeSnapshot &s = snapshots.back();
+        s.tracks = numTracks;
+        s.sampleRate = rate;
+        for(int t = 0; t < numTracks; t++){
+            const float *ring = &history[(size_t)t * ScopeSnapshot::samples];
+            int head = heads[t];
+            std::copy(ring + head, ring + ScopeSnapshot::samples, s.wave[t]);
+            std::copy(ring, ring + head, s.wave[t] + (ScopeSnapshot::samples - head));
+        }
+        s.strings = strings;
+        std::copy(levels, levels + strings, s.stringLevel);
+        strings = 0;
+        snapshots.publish();
+    }
+
+    // UI thread: the newest snapshot, or null when nothing new arrived
+    const ScopeSnapshot *latest(){
+        return snapshots.update() ? &snapshots.front() : nullptr;
+    }
+
+private:
+    static_assert((ScopeSnapshot::samples & (ScopeSnapshot::samples - 1)) == 0,
+                  "scope history must be a power of two");
+
+    TripleBuffer<ScopeSnapshot> snapshots;
+    int numTracks = 0;
+    double rate = 44100;
+    std::vector<float> history;   // one ring per track
+    std::vector<int> heads;
+    float levels[ScopeSnapshot::maxStrings];
+    int strings = 0;
+};
+
+// Graphics-thread side: draws an oscilloscope per track, the spectrum of
+// their mix and the string levels in an ImGui window, from the newest
+// snapshot. The FFT runs here at frame rate, not in the audio callback.
+// Call draw() between imguiBeginFrame() and imguiEndFrame().
+class ScopeView {
+public:
+    static const int scopeSamples = 1024;   // shown per trace
+    static const int spectrumPoints = 256;  // log-spaced, 20 Hz to Nyquist
+
+    ScopeView()
+        : fft(ScopeSnapshot::samples),
+          window(ScopeSnapshot::samples),
+          mix(ScopeSnapshot::samples),
+          re(ScopeSnapshot::samples / 2 + 1),
+          im(ScopeSnapshot::samples / 2 + 1),
+          spectrum(spectrumPoints, -120.f),
+          traces(ScopeSnapshot::maxTracks * scopeSamples, 0.f),
+          levels(ScopeSnapshot::maxStrings, 0.f) {
+        const double twoPi = 6.283185307179586;
+        for(int i = 0; i < ScopeSnapshot::samples; i++){
+            window[i] = (float)(0.5 - 0.5 * std::cos(twoPi * i / ScopeSnapshot::samples));
+        }
+    }
+
+    void draw(ScopeFeed &feed){
+        if(const ScopeSnapshot *s = feed.latest()){
+            analyze(*s);
+        }
+        ImGui::Begin("Scope");
+        char label[32];
+        for(int t = 0; t < tracks; t++){
+            std::snprintf(label, sizeof(label), "track %d", t);
+            ImGui::PlotLines(label, &traces[(size_t)t * scopeSamples], scopeSamples,
+                             0, nullptr, -1.f, 1.f, ImVec2(-1, 80));
+        }
+        ImGui::PlotLines("spectrum dB", spectrum.data(), spectrumPoints,
+                         0, nullptr, -120.f, 0.f, ImVec2(-1, 120));
+        std::snprintf(label, sizeof(label), "%d strings", strings);
+        ImGui::PlotHistogram(label, levels.data(), std::max(1, strings),
+                             0, nullptr, 0.f, 0.5f, ImVec2(-1, 60));
+        ImGui::End();
+    }
+
+private:
+    void analyze(const ScopeSnapshot &s){
+        const int n = ScopeSnapshot::samples;
+        tracks = s.tracks;
+        std::fill(mix.begin(), mix.end(), 0.f);
+        for(int t = 0; t < tracks; t++){
+            const float *w = s.wave[t];
+            // start the trace on a rising zero crossing so it stands still
+            int start = n - scopeSamples;
+            for(int i = n - scopeSamples; i > 1; i--){
+                if(w[i - 1] < 0.f && w[i] >= 0.f){
+                    start = i;
+                    break;
+                }
+            }
+            std::copy(w + start, w + start + scopeSamples, &traces[(size_t)t * scopeSamples]);
+            for(int i = 0; i < n; i++){
+                mix[i] += w[i];
+            }
+        }
+
+        for(int i = 0; i < n; i++){
+            mix[i] *= window[i];
+        }
+        fft.forward(mix.data(), re.data(), im.data());
+        // window gain 0.5, so a full-scale sine reads 0 dB
+        const float norm = 4.f / n;
+        const double nyquist = s.sampleRate / 2;
+        for(int p = 0; p < spectrumPoints; p++){
+            double f = 20.0 * std::pow(nyquist / 20.0, (double)p / (spectrumPoints - 1));
+            int bin = std::min(n / 2, (int)(f / nyquist * (n / 2)));
+            float mag = std::sqrt(re[bin] * re[bin] + im[bin] * im[bin]) * norm;
+            spectrum[p] = std::max(-120.f, 20.f * std::log10(mag + 1e-9f));
+        }
+
+        strings = s.strings;
+        std::copy(s.stringLevel, s.stringLevel + strings, levels.begin());
+    }
+
+    RealFFT fft;
+    std::vector<float> window;
+    std::vector<float> mix;
+    std::vector<float> re, im;
+    std::vector<float> spectrum;
+    std::vector<float> traces;   // per track, scopeSamples each
+    std::vector<float> levels;
+    int tracks = 0;
+    int strings = 0;
+};
+
+#endif
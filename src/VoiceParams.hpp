@@ -0,0 +1,70 @@
+#ifndef VOICEPARAMS_HPP
+#define VOICEPARAMS_HPP
+
+#include "al/ui/al_Parameter.hpp"
+
+// Typed handle to one of a voice's internal trigger parameters. Bind it in
+// init() to the Parameter returned by createInternalTriggerParameter() and
+// read it once per block with snapshot(), instead of looking the parameter
+// up by name for every sample.
+class VoiceParam {
+public:
+    void bind(al::Parameter &p){
+        param = &p;
+        value = p.get();
+    }
+    float snapshot(){
+        value = param->get();
+        return value;
+    }
+    float get() const {
+        return value;
+    }
+    // writes the parameter itself, e.g. to set up a voice before a trigger
+    void set(float v){
+        param->set(v);
+        value = v;
+    }
+protected:
+    al::Parameter * param = nullptr;
+    float value = 0;
+};
+
+// Parameter applied per sample. A change seen by snapshot() is ramped
+// linearly across the block so it does not step (zipper noise); next()
+// yields one value per frame, and the following block starts on the new
+// value.
+class SmoothedParam : public VoiceParam {
+public:
+    // jump straight to the current value, e.g. when a note starts
+    void reset(){
+        reset(VoiceParam::snapshot());
+    }
+    void reset(float v){
+        value = v;
+        current = v;
+        end = v;
+        step = 0;
+    }
+    void snapshot(int frames){
+        snapshot(frames, VoiceParam::snapshot());
+    }
+    // same, with the value coming from somewhere other than the parameter
+    void snapshot(int frames, float target){
+        value = target;
+        current = end;
+        end = target;
+        step = (frames > 0) ? (end - current) / frames : 0;
+    }
+    float next(){
+        float v = current;
+        current += step;
+        return v;
+    }
+private:
+    float current = 0;
+    float end = 0;
+    float step = 0;
+};
+
+#endif
@@ -0,0 +1,245 @@
+#ifndef VOICEPOOL_HPP
+#define VOICEPOOL_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "al/io/al_AudioIOData.hpp"
+
+#include "GuitarVoice.hpp"
+#include "InstrumentGroup.hpp"
+
+// Fixed set of GuitarVoices, allocated up front, with a hard cap on how
+// many notes sound at once. Once the cap is reached, a new note takes over
+// a sounding one. A note on the same pitch is re-plucked in place.
+// Otherwise the oldest or quietest note is faded out over a few
+// milliseconds, and the new note starts on one of a few headroom voices
+// kept for those fades. If the headroom is used up too, the note is dropped
+// and counted, and nothing is stolen for it. Nothing is allocated after
+// allocate(), and the CPU cost is bounded by the polyphony.
+//
+// The pool owns its voices, hands them out from its own free list and
+// renders them itself. It does not go through al::PolySynth, whose
+// getVoice() and triggerOn() lock mutexes and compare type names held in
+// std::strings, none of which belongs on the audio thread.
+//
+// noteOn(), noteOff(), render() and reclaim() must be called from the same
+// thread, or from threads taking turns; only the parts of one block may
+// render at once.
+class VoicePool {
+public:
+    enum StealPolicy { StealOldest, StealQuietest };
+
+    // Creates polyphony + headroom voices, initialized and bound to group
+    // (which may be null). Call before audio starts.
+    void allocate(int polyphony, InstrumentGroup *group = nullptr, int headroom = -1){
+        cap = std::max(1, polyphony);
+        spare = headroom >= 0 ? headroom : std::max(2, cap / 4);
+        this->group = group;
+        voices.clear();
+        idle.clear();
+        for(int i = 0; i < cap + spare; i++){
+            voices.emplace_back(new GuitarVoice);
+            voices.back()->init();
+            idle.push_back(voices.back().get());
+        }
+        playing.clear();
+        playing.reserve(cap + spare);
+    }
+
+    // Sizes every voice's scratch for blocks of up to maxFrames; larger
+    // blocks render in chunks. Call after allocate(), before audio starts.
+    void prepare(int maxFrames){
+        for(auto &voice : voices){
+            voice->prepare(maxFrames);
+        }
+    }
+
+    void policy(StealPolicy p){
+        stealPolicy = p;
+    }
+    // a new note on a pitch that is already sounding re-plucks that voice
+    void retriggerSamePitch(bool on){
+        samePitch = on;
+    }
+    void fadeTime(float seconds){
+        fadeSeconds = seconds;
+    }
+
+    int polyphony() const {
+        return cap;
+    }
+    // voices allocated, headroom included
+    int capacity() const {
+        return (int)voices.size();
+    }
+    int sounding() const {
+        return (int)playing.size();
+    }
+    uint32_t stolen() const {
+        return numStolen;
+    }
+    uint32_t dropped() const {
+        return numDropped;
+    }
+
+    // calls f(voice) for every voice still sounding; same thread rules as
+    // noteOn()
+    template <typename F>
+    void forEachSounding(F &&f) const {
+        for(const auto &p : playing){
+            if(p.voice->active()){
+                f(*p.voice);
+            }
+        }
+    }
+
+    // Starts `note` at a frame offset into the next block.
+    void noteOn(int note, float frequency, int offset){
+        noteOn(note, frequency, offset, [](GuitarVoice &){});
+    }
+    // Same, with setup(voice) called on a newly taken voice before it is
+    // triggered, to set its other trigger parameters.
+    template <typename Setup>
+    void noteOn(int note, float frequency, int offset, Setup &&setup){
+        reclaim();
+
+        if(samePitch){
+            for(auto &p : playing){
+                if(!p.voice->fading() && p.frequency == frequency){
+                    setup(*p.voice);   // the new note's parameters
+                    p.voice->retriggerAt(offset);
+                    p.note = note;
+                    p.started = nextStart++;
+                    return;
+                }
+            }
+        }
+
+        // every voice, headroom included, is sounding or fading
+        if(idle.empty()){
+            numDropped++;
+            return;
+        }
+        int live = 0;
+        for(auto &p : playing){
+            live += p.voice->fading() ? 0 : 1;
+        }
+        if(live >= cap){
+            Playing *victim = choose();
+            if(victim){
+                victim->voice->fadeOutAt(offset, fadeSeconds);
+                numStolen++;
+            }
+        }
+
+        GuitarVoice *voice = idle.back();
+        idle.pop_back();
+        setup(*voice);
+        voice->group(group);
+        voice->mFrequency.set(frequency);
+        voice->id(note);
+        voice->triggerOn(offset);
+
+        Playing p;
+        p.voice = voice;
+        p.note = note;
+        p.frequency = frequency;
+        p.started = nextStart++;
+        playing.push_back(p);
+    }
+
+    // Releases `note` at a frame offset into the next block. A note that
+    // was stolen or re-plucked by a later one is ignored.
+    void noteOff(int note, int offset){
+        for(auto &p : playing){
+            if(p.note == note && !p.voice->fading()){
+                p.voice->releaseAt(offset);
+                return;
+            }
+        }
+    }
+
+    // Adds `frames` samples of every sounding voice into left and right,
+    // each from the frame it starts on, and takes back the voices that
+    // finished.
+    void render(float *left, float *right, int frames, double sampleRate){
+        render(left, right, frames, sampleRate, 0, 1);
+        reclaim();
+    }
+    // Same for part `part` of `parts` of the sounding voices, without
+    // taking any back. Different parts touch different voices and may
+    // render concurrently; call reclaim() once they all have.
+    void render(float *left, float *right, int frames, double sampleRate,
+                int part, int parts){
+        int n = (int)playing.size();
+        int end = (int)((int64_t)n * (part + 1) / parts);
+        for(int i = (int)((int64_t)n * part / parts); i < end; i++){
+            GuitarVoice *voice = playing[i].voice;
+            if(!voice->active()){
+                continue;
+            }
+            int start = voice->getStartOffsetFrames(frames);
+            if(start < frames){
+                voice->render(left, right, start, frames, sampleRate);
+            }
+        }
+    }
+    // same, into the first two channels of io
+    void render(al::AudioIOData &io){
+        render(io.outBuffer(0), io.outBuffer(1), io.framesPerBuffer(), io.framesPerSecond());
+    }
+
+    // puts voices that have finished back on the free list
+    void reclaim(){
+        size_t kept = 0;
+        for(size_t i = 0; i < playing.size(); i++){
+            if(playing[i].voice->active()){
+                playing[kept++] = playing[i];
+            } else {
+                idle.push_back(playing[i].voice);
+            }
+        }
+        playing.resize(kept);
+    }
+
+private:
+    struct Playing {
+        GuitarVoice *voice;
+        int note;
+        float frequency;
+        uint64_t started;
+    };
+
+    Playing *choose(){
+        Playing *best = nullptr;
+        for(auto &p : playing){
+            if(p.voice->fading()){
+                continue;
+            }
+            if(!best
+               || (stealPolicy == StealOldest && p.started < best->started)
+               || (stealPolicy == StealQuietest && p.voice->level() < best->voice->level())){
+                best = &p;
+            }
+        }
+        return best;
+    }
+
+    InstrumentGroup *group = nullptr;
+    std::vector<std::unique_ptr<GuitarVoice>> voices;
+    std::vector<GuitarVoice *> idle;   // free list
+    std::vector<Playing> playing;
+    int cap = 16;
+    int spare = 4;
+    StealPolicy stealPolicy = StealOldest;
+    bool samePitch = true;
+    float fadeSeconds = 0.005f;
+    uint64_t nextStart = 0;
+    uint32_t numStolen = 0;
+    uint32_t numDropped = 0;
+};
+
+#endif
@@ -0,0 +1,509 @@
+// Microbenchmarks for the guitar DSP hot paths.
+//
+//   bench [out.json]
+//
+// Prints (or writes) one JSON document so results can be diffed between
+// builds. Everything is seeded and runs a fixed amount of work, so two runs
+// on the same machine measure the same thing.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Gamma/Oscillator.h"
+#include "al/io/al_AudioIOData.hpp"
+
+#include "AdditiveOsc.hpp"
+#include "AmpStage.hpp"
+#include "Convolver.hpp"
+#include "Denormals.hpp"
+#include "Excitation.hpp"
+#include "GuitarString.hpp"
+#include "GuitarStringBank.hpp"
+#include "GuitarVoice.hpp"
+#include "ImpulseResponse.hpp"
+
+using namespace al;
+
+static const double kSampleRate = 44100.;
+static const int kBlockSize = 512;
+static const double kFrequencies[] = {82.41, 110.0, 146.83, 196.0, 246.94, 329.63};
+static const int kNumFrequencies = 6;
+
+static volatile float sink;
+
+typedef std::chrono::steady_clock Clock;
+
+static double nanosSince(Clock::time_point start){
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+struct Result {
+    std::string name;
+    double value;
+    std::string unit;
+};
+
+// per-sample sample()/tic() calls, the path GuitarVoice used originally
+static double benchStringTic(){
+    const int blocks = 2000;
+    double total = 0;
+    for(int f = 0; f < kNumFrequencies; f++){
+        GuitarString s(kFrequencies[f]);
+        s.pluck();
+        float acc = 0;
+        auto start = Clock::now();
+        for(int b = 0; b < blocks; b++){
+            for(int i = 0; i < kBlockSize; i++){
+                acc += s.sample();
+                s.tic();
+            }
+        }
+        total += nanosSince(start);
+        sink = acc;
+    }
+    return total / ((double)kNumFrequencies * blocks * kBlockSize);
+}
+
+static double benchStringProcess(){
+    const int blocks = 2000;
+    std::vector<float> out(kBlockSize);
+    double total = 0;
+    for(int f = 0; f < kNumFrequencies; f++){
+        GuitarString s(kFrequencies[f]);
+        s.pluck();
+        auto start = Clock::now();
+        for(int b = 0; b < blocks; b++){
+            s.process(out.data(), kBlockSize);
+        }
+        total += nanosSince(start);
+        sink = out[0];
+    }
+    return total / ((double)kNumFrequencies * blocks * kBlockSize);
+}
+
+// Karplus-Strong without the denormal bias, as the kernel was before, so
+// the decayed-string numbers show what the bias protects against.
+struct UnguardedString {
+    static const unsigned mask = 4095;
+    std::vector<float> line;
+    unsigned writePos = 0;
+    int length;
+
+    explicit UnguardedString(double freq)
+        : line(mask + 1, 0.f), length((int)(kSampleRate / freq)) {}
+    void pluck(){
+        XorShift32 random(1);
+        for(int i = 0; i < length; i++){
+            line[writePos++ & mask] = random.nextFloat();
+        }
+    }
+    void process(float * out, int frames){
+        for(int i = 0; i < frames; i++){
+            unsigned r = (writePos - length) & mask;
+            float a = line[r];
+            line[writePos++ & mask] = (a + line[(r + 1) & mask]) * (0.5f * .996f);
+            out[i] += a;
+        }
+    }
+};
+
+// samples until a 110 Hz string without the bias has decayed into the
+// denormal range (below 1e-37)
+static long samplesUntilDenormal(){
+    UnguardedString s(110.0);
+    s.pluck();
+    std::vector<float> out(kBlockSize);
+    long n = 0;
+    float peak = 1;
+    while(peak > 1e-37f && n < (long)(1000 * kSampleRate)){
+        std::fill(out.begin(), out.end(), 0.f);
+        s.process(out.data(), kBlockSize);
+        n += kBlockSize;
+        peak = 0;
+        for(float x : out){
+            peak = std::max(peak, std::abs(x));
+        }
+    }
+    return n;
+}
+
+// ns per sample for a 110 Hz string after `decay` samples of ringing, with
+// denormal flushing off unless `ftz`
+template <typename String>
+static double benchDecayedString(long decay, bool ftz){
+    const int blocks = 500;
+    String s(110.0);
+    s.pluck();
+    std::vector<float> out(kBlockSize);
+    for(long n = 0; n < decay; n += kBlockSize){
+        s.process(out.data(), kBlockSize);
+    }
+    flushDenormals(ftz);
+    auto start = Clock::now();
+    for(int b = 0; b < blocks; b++){
+        s.process(out.data(), kBlockSize);
+    }
+    double total = nanosSince(start);
+    flushDenormals(false);
+    sink = out[0];
+    return total / ((double)blocks * kBlockSize);
+}
+
+// ns per sample per string with every slot of a bank sounding; retirement
+// is off so no string goes quiet during the run
+static double benchBankProcess(){
+    const int blocks = 2000;
+    GuitarStringBank bank(8, kSampleRate, 0.f);
+    const ExcitationBank &excitations = ExcitationBank::shared();
+    for(int i = 0; i < bank.size(); i++){
+        bank.pluck(kFrequencies[i % kNumFrequencies],
+                   excitations.get(ExcitationBank::Noise, i * 7919));
+    }
+    std::vector<float> out(kBlockSize);
+    long strings = 0;
+    auto start = Clock::now();
+    for(int b = 0; b < blocks; b++){
+        strings += bank.activeStrings();
+        bank.process(out.data(), kBlockSize);
+    }
+    double total = nanosSince(start);
+    sink = out[0];
+    return total / ((double)strings * kBlockSize);
+}
+
+// ns per trigger for the lowest string the voices allow (20 Hz, longest copy)
+static double benchPluck(ExcitationBank::Type type){
+    const int plucks = 20000;
+    GuitarStringBank bank(8);
+    const ExcitationBank &excitations = ExcitationBank::shared();
+    XorShift32 random(1);
+    auto start = Clock::now();
+    for(int i = 0; i < plucks; i++){
+        bank.pluck(20.0, excitations.get(type, random.next()));
+    }
+    return nanosSince(start) / plucks;
+}
+
+// Bank of quadrature oscillators, one per harmonic, the alternative to
+// AdditiveTable for weights that change while the note plays. No voice
+// needs that, so it lives here as the wavetable's point of comparison.
+// Each harmonic is a (cos, sin) pair rotated once per sample. The state is
+// kept structure-of-arrays so one rotation step runs across all harmonics
+// as a vector loop. The weighted sum is a float reduction, which the
+// compiler may not reorder without -ffast-math, so it is accumulated in one
+// partial sum per vector lane and only those are added up in order at the
+// end. A frequency change only swaps the rotation coefficients, so phases
+// stay continuous. Harmonics at or above Nyquist are skipped.
+class SineBank {
+public:
+    static const int maxHarmonics = 64;   // a whole number of lanes
+    static const int lanes = 8;
+
+    SineBank(){
+        std::fill(weights, weights + maxHarmonics, 0.f);
+        std::fill(mixWeights, mixWeights + maxHarmonics, 0.f);
+        reset();
+    }
+    void weight(int harmonic, float w){
+        weights[harmonic - 1] = w;
+        if(harmonic <= active){
+            mixWeights[harmonic - 1] = w;
+        }
+    }
+    void harmonics(int count){
+        numHarmonics = std::min(count, maxHarmonics);
+        freq(frequency, rate);
+    }
+    void freq(float f, float sampleRate){
+        frequency = f;
+        rate = sampleRate;
+        active = std::min(numHarmonics, (int)(0.5f * sampleRate / f));
+        for(int h = 0; h < active; h++){
+            double w = 6.283185307179586 * (h + 1) * f / sampleRate;
+            rotCos[h] = (float)std::cos(w);
+            rotSin[h] = (float)std::sin(w);
+        }
+        for(int h = 0; h < maxHarmonics; h++){
+            mixWeights[h] = h < active ? weights[h] : 0.f;
+        }
+    }
+    void reset(){
+        std::fill(c, c + maxHarmonics, 1.f);
+        std::fill(s, s + maxHarmonics, 0.f);
+    }
+
+    // adds `frames` samples of the weighted sum into out
+    void process(float *out, int frames){
+        const int n = active;
+        const int padded = (n + lanes - 1) / lanes * lanes;
+        for(int i = 0; i < frames; i++){
+            // harmonics past n up to padded have zero mix weight
+            float partial[lanes] = {};
+            for(int h = 0; h < padded; h += lanes){
+                for(int l = 0; l < lanes; l++){
+                    partial[l] += mixWeights[h + l] * s[h + l];
+                }
+            }
+            float sum = 0;
+            for(int l = 0; l < lanes; l++){
+                sum += partial[l];
+            }
+            out[i] += sum;
+            for(int h = 0; h < n; h++){
+                float nc = c[h] * rotCos[h] - s[h] * rotSin[h];
+                float ns = c[h] * rotSin[h] + s[h] * rotCos[h];
+                c[h] = nc;
+                s[h] = ns;
+            }
+        }
+        // rotation in float slowly drifts off the unit circle
+        for(int h = 0; h < n; h++){
+            float g = 1.f / std::sqrt(c[h] * c[h] + s[h] * s[h]);
+            c[h] *= g;
+            s[h] *= g;
+        }
+    }
+
+private:
+    float weights[maxHarmonics];
+    float mixWeights[maxHarmonics];   // weights, 0 at and above Nyquist
+    float c[maxHarmonics];
+    float s[maxHarmonics];
+    float rotCos[maxHarmonics] = {};
+    float rotSin[maxHarmonics] = {};
+    int numHarmonics = 1;
+    int active = 0;
+    float frequency = 440;
+    float rate = 44100;
+};
+
+// six harmonics, the SineEnv timbre, table lookup vs quadrature bank
+static double benchAdditiveTable(){
+    const int blocks = 2000;
+    AdditiveTable table({1.f, 1.f/2, 1.f/3, 1.f/4, 1.f/5, 1.f/6});
+    WavetableOsc osc;
+    osc.source(&table);
+    osc.freq(220.f, kSampleRate);
+    std::vector<float> out(kBlockSize);
+    auto start = Clock::now();
+    for(int b = 0; b < blocks; b++){
+        for(int i = 0; i < kBlockSize; i++){
+            out[i] = osc();
+        }
+        sink = out[b % kBlockSize];
+    }
+    return nanosSince(start) / ((double)blocks * kBlockSize);
+}
+
+static double benchAdditiveBank(){
+    const int blocks = 2000;
+    SineBank bank;
+    bank.harmonics(6);
+    for(int h = 1; h <= 6; h++){
+        bank.weight(h, 1.f / h);
+    }
+    bank.freq(220.f, kSampleRate);
+    std::vector<float> out(kBlockSize);
+    auto start = Clock::now();
+    for(int b = 0; b < blocks; b++){
+        bank.process(out.data(), kBlockSize);
+    }
+    sink = out[0];
+    return nanosSince(start) / ((double)blocks * kBlockSize);
+}
+
+// one channel of the track body stage, IR of the given length
+static double benchBodyConvolve(double irSeconds){
+    const int blocks = 500;
+    auto ir = std::make_shared<const PartitionedIR>(
+        syntheticBodyIR(kSampleRate, irSeconds), kBlockSize);
+    Convolver body;
+    body.prepare(ir, Convolver::ZeroLatency);
+    std::vector<float> buf(kBlockSize);
+    XorShift32 random(1);
+    for(auto &x : buf){
+        x = random.nextFloat();
+    }
+    auto start = Clock::now();
+    for(int b = 0; b < blocks; b++){
+        body.process(buf.data(), kBlockSize);
+    }
+    sink = buf[0];
+    return nanosSince(start) / blocks;
+}
+
+// one channel of the track amp stage at the given oversampling
+static double benchAmp(int oversampling){
+    const int blocks = 500;
+    AmpStage amp;
+    amp.prepare(oversampling, 1, kBlockSize);
+    amp.drive(24);
+    std::vector<float> buf(kBlockSize);
+    XorShift32 random(1);
+    auto start = Clock::now();
+    for(int b = 0; b < blocks; b++){
+        for(auto &x : buf){
+            x = random.nextFloat();
+        }
+        float *channel = buf.data();
+        amp.process(&channel, 1, kBlockSize);
+    }
+    sink = buf[0];
+    return nanosSince(start) / blocks;
+}
+
+struct VoiceRig {
+    AudioIOData io;
+    std::vector<std::unique_ptr<GuitarVoice>> voices;
+
+    VoiceRig(){
+        io.framesPerSecond(kSampleRate);
+        io.framesPerBuffer(kBlockSize);
+        io.channelsOut(2);
+    }
+    void addVoices(int count){
+        for(int i = 0; i < count; i++){
+            std::unique_ptr<GuitarVoice> v(new GuitarVoice);
+            v->init();
+            v->notesPlayed.retireBelow(0.f);   // keep every string sounding
+            v->mFrequency.set(kFrequencies[voices.size() % kNumFrequencies]);
+            v->onTriggerOn();
+            voices.push_back(std::move(v));
+        }
+    }
+    // ns to render one block with all voices
+    double renderBlock(){
+        io.zeroOut();
+        auto start = Clock::now();
+        for(auto &v : voices){
+            io.frame(0);
+            v->onProcess(io);
+        }
+        double ns = nanosSince(start);
+        sink = io.outBuffer(0)[0];
+        return ns;
+    }
+    double medianBlock(int blocks){
+        std::vector<double> times(blocks);
+        for(int b = 0; b < blocks; b++){
+            times[b] = renderBlock();
+        }
+        std::nth_element(times.begin(), times.begin() + blocks / 2, times.end());
+        return times[blocks / 2];
+    }
+};
+
+static double benchVoiceBlock(){
+    VoiceRig rig;
+    rig.addVoices(1);
+    rig.medianBlock(50);
+    return rig.medianBlock(2000);
+}
+
+// Adds voices until the median block render time exceeds the block period,
+// doubling first and then bisecting. Returns the largest count that fit.
+static int benchMaxVoices(double deadlineNs, int maxVoices, double &blockNsAtMax){
+    VoiceRig rig;
+    int good = 0;
+    int bad = 0;
+    double goodNs = 0;
+    for(int n = 8; n <= maxVoices; n *= 2){
+        rig.addVoices(n - (int)rig.voices.size());
+        double ns = rig.medianBlock(32);
+        if(ns > deadlineNs){
+            bad = n;
+            break;
+        }
+        good = n;
+        goodNs = ns;
+    }
+    if(bad > 0){
+        rig.voices.resize(good);
+        while(bad - good > 1){
+            int mid = (good + bad) / 2;
+            if((int)rig.voices.size() > mid){
+                rig.voices.resize(mid);
+            } else {
+                rig.addVoices(mid - (int)rig.voices.size());
+            }
+            double ns = rig.medianBlock(32);
+            if(ns > deadlineNs){
+                bad = mid;
+            } else {
+                good = mid;
+                goodNs = ns;
+            }
+        }
+    }
+    blockNsAtMax = goodNs;
+    return good;
+}
+
+int main(int argc, char *argv[]) {
+    gam::sampleRate(kSampleRate);
+    srand(1);
+
+    std::vector<Result> results;
+    results.push_back({"string_tic", benchStringTic(), "ns/sample"});
+    results.push_back({"string_process", benchStringProcess(), "ns/sample"});
+    results.push_back({"bank_process", benchBankProcess(), "ns/sample/string"});
+    long decay = samplesUntilDenormal();
+    results.push_back({"string_fresh", benchDecayedString<GuitarString>(0, false), "ns/sample"});
+    results.push_back({"string_decayed", benchDecayedString<GuitarString>(decay, false), "ns/sample"});
+    results.push_back({"unguarded_fresh", benchDecayedString<UnguardedString>(0, false), "ns/sample"});
+    results.push_back({"unguarded_decayed", benchDecayedString<UnguardedString>(decay, false), "ns/sample"});
+    results.push_back({"unguarded_decayed_ftz", benchDecayedString<UnguardedString>(decay, true), "ns/sample"});
+    results.push_back({"bank_pluck_noise", benchPluck(ExcitationBank::Noise), "ns/trigger"});
+    results.push_back({"bank_pluck_shape", benchPluck(ExcitationBank::PickCenter), "ns/trigger"});
+    results.push_back({"voice_block", benchVoiceBlock(), "ns/block"});
+    results.push_back({"additive_table", benchAdditiveTable(), "ns/sample"});
+    results.push_back({"additive_bank", benchAdditiveBank(), "ns/sample"});
+    results.push_back({"body_convolve_300ms", benchBodyConvolve(0.3), "ns/block"});
+    results.push_back({"body_convolve_3s", benchBodyConvolve(3.0), "ns/block"});
+    results.push_back({"amp_2x", benchAmp(2), "ns/block"});
+    results.push_back({"amp_4x", benchAmp(4), "ns/block"});
+    results.push_back({"amp_8x", benchAmp(8), "ns/block"});
+
+    const double deadlineNs = 1e9 * kBlockSize / kSampleRate;
+    const int maxVoices = 4096;
+    double blockNsAtMax = 0;
+    int maxRealtimeVoices = benchMaxVoices(deadlineNs, maxVoices, blockNsAtMax);
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"sample_rate\": " << kSampleRate << ",\n";
+    json << "  \"block_size\": " << kBlockSize << ",\n";
+    json << "  \"kernels\": \"" << dspKernels().isa << "\",\n";
+    json << "  \"benchmarks\": [\n";
+    for(size_t i = 0; i < results.size(); i++){
+        json << "    {\"name\": \"" << results[i].name << "\", \"value\": "
+             << results[i].value << ", \"unit\": \"" << results[i].unit << "\"}"
+             << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    json << "  ],\n";
+    json << "  \"stress\": {\"deadline_ns\": " << deadlineNs
+         << ", \"max_realtime_voices\": " << maxRealtimeVoices
+         << ", \"voice_cap\": " << maxVoices
+         << ", \"block_ns_at_max\": " << blockNsAtMax << "}\n";
+    json << "}\n";
+
+    if(argc > 1){
+        std::ofstream file(argv[1]);
+        file << json.str();
+        if(!file){
+            std::cerr << "could not write " << argv[1] << std::endl;
+            return 1;
+        }
+    } else {
+        std::cout << json.str();
+    }
+    return 0;
+}
@@ -1,5 +1,11 @@
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
 #include "Gamma/Analysis.h"
 #include "Gamma/Effects.h"
 #include "Gamma/Envelope.h"
@@ -9,343 +15,341 @@
 #include "al/scene/al_PolySynth.hpp"
 #include "al/scene/al_SynthSequencer.hpp"
 #include "al/ui/al_ControlGUI.hpp"
+#include "EventLog.hpp"
+#include "Convolver.hpp"
+#include "Denormals.hpp"
+#include "GuitarVoice.hpp"
+#include "EventScheduler.hpp"
+#include "ImpulseResponse.hpp"
+#include "LatencyManager.hpp"
+#include "LoadMeter.hpp"
+#include "NoteCache.hpp"
+#include "OfflineRender.hpp"
+#include "ParallelRenderer.hpp"
+#include "RtCheck.hpp"
+#include "Score.hpp"
+#include "SineEnv.hpp"
+#include "Track.hpp"
+#include "Visualizer.hpp"
+#include "VoicePool.hpp"
 
 using namespace al;
 
+// reports the level of every string the pool's voices have sounding
+static void scopeStrings(const VoicePool &pool, ScopeFeed &scope){
+    pool.forEachSounding([&scope](const GuitarVoice &voice){
+        for(int s = 0; s < voice.notesPlayed.size(); s++){
+            float level = voice.notesPlayed.level(s);
+            if(level > 0.f){
+                scope.stringLevel(level);
+            }
+        }
+    });
+}
 
-class SineEnv : public al::SynthVoice
-{
-public:
-    // Unit generators
-    gam::Pan<> mPan;
-    gam::Sine<> mOsc;
-    gam::Sine<> mOsc1;
-    gam::Sine<> mOsc2;
-    gam::Sine<> mOsc3;
-    gam::Sine<> mOsc4;
-    gam::Sine<> mOsc5;
-    gam::Sine<> mOsc6;
-    gam::Sine<> mOsc7;
-    gam::Sine<> mOsc8;
-    gam::Sine<> mOsc9;
-    gam::Sine<> mOsc10;
-    gam::Sine<> mOsc11;
-    gam::Sine<> mOsc12;
-    gam::Env<3> mAmpEnv;
-    void init() override
-    {
-        // Intialize envelope
-        mAmpEnv.curve(0); // make segments lines
-        mAmpEnv.levels(0, 1, 1, 0);
-        mAmpEnv.sustainPoint(2); // Make point 2 sustain until a release is issued
-
-        createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0);
-        createInternalTriggerParameter("frequency", 60, 20, 5000);
-        createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0);
-        createInternalTriggerParameter("releaseTime", 0.1, 0.1, 10.0);
-        createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
+struct MyApp : public App {
+    static const int numTracks = 3;
+    NoteCache cache;   // disabled until noteCache()
+    Track tracks[numTracks];
+    EventScheduler scheduler;   // note events of every track, in time order
+    std::unique_ptr<ParallelRenderer> parallel; // renders the tracks, set by renderThreads()
+    std::unique_ptr<ScoreFile> score;   // null: play the built-in score
+    LoadReport load;
+    ScopeFeed scope;       // written by the audio thread
+    ScopeView scopeView;   // drawn by the graphics thread
+
+    // Preallocates every voice the tracks may use, for blocks of up to
+    // blockSize. Call before audio starts.
+    void polyphony(int voicesPerTrack, double sampleRate, int blockSize){
+        gam::sampleRate(sampleRate);   // the voices' strings tune to it
+        for(auto &track : tracks){
+            track.voices.allocate(voicesPerTrack, &track.group);
+            track.voices.prepare(blockSize);
+        }
     }
 
-    // The audio processing function
-    void onProcess(AudioIOData &io) override
-    {
-        float f = getInternalParameterValue("frequency");
-        mOsc.freq(f);
-        mOsc1.freq(f * 2);
-        mOsc2.freq(f * 3);
-        mOsc3.freq(f * 4);
-        mOsc4.freq(f * 5);
-        mOsc5.freq(f * 6);
-
-        mAmpEnv.lengths()[0] = getInternalParameterValue("attackTime");
-        mAmpEnv.lengths()[2] = getInternalParameterValue("releaseTime");
-        mPan.pos(getInternalParameterValue("pan"));
-        while (io())
-        {
-            float s1 = (mOsc() + (mOsc1()/2) + (mOsc2()/3) + (mOsc3()/4) + (mOsc4()/5) + (mOsc5()/6)) * mAmpEnv() * getInternalParameterValue("amplitude");
-            float s2;
-            mPan(s1, s1, s2);
-            io.out(0) += s1;
-            io.out(1) += s2;
+    // Loads the body impulse response every track is convolved with, or
+    // synthesizes one when irPath is empty; "off" disables the body stage.
+    // Also lays out `channels` speakers for the tracks to be placed among.
+    // Call before audio starts.
+    bool bodyResonance(const std::string &irPath, double sampleRate,
+                       int blockSize, int channels){
+        std::shared_ptr<const PartitionedIR> partitioned;
+        if(irPath != "off"){
+            std::vector<float> ir;
+            double irRate = sampleRate;
+            if(irPath.empty()){
+                ir = syntheticBodyIR(sampleRate);
+            } else if(!loadImpulseResponse(irPath, ir, irRate)){
+                std::cerr << "could not read impulse response " << irPath << std::endl;
+                return false;
+            }
+            if(irRate != sampleRate){
+                std::cerr << irPath << " is " << irRate << " Hz, playing it at "
+                          << sampleRate << " Hz" << std::endl;
+            }
+            // partitions of one block add no latency; the FFT needs a power of two
+            int partition = 1;
+            while(partition < blockSize){
+                partition *= 2;
+            }
+            partitioned = std::make_shared<const PartitionedIR>(ir, partition);
+        }
+        SpeakerLayout layout = SpeakerLayout::forChannels(channels);
+        scope.prepare(numTracks, sampleRate);
+        for(int t = 0; t < numTracks; t++){
+            tracks[t].prepare(sampleRate, blockSize, layout, partitioned);
+            tracks[t].tap(&scope, t);
+            // around a ring, each track gets its own sector
+            if(layout.ring){
+                tracks[t].position(360.f * t / numTracks, 360.f / numTracks);
+            }
         }
-        if (mAmpEnv.done())
-            free();
+        return true;
     }
 
-    void onTriggerOn() override { mAmpEnv.reset(); }
-
-    void onTriggerOff() override { mAmpEnv.release(); }
-};
-
-struct SynthParams{
-    float attack;
-    float volume;
-    float tempo;
-};
-
-class RingBuffer {
-public:
-    RingBuffer(int capacity){
-        sizeTotal = capacity;
-        sizeCurr = 0;
-        rb = new double[capacity];
-        firstIndex = 0;
-        lastIndex = 1;
-    }
-    int size(){
-        return sizeCurr;
-    }
-    bool isEmpty(){
-        return (sizeCurr == 0);
-    }
-    bool isFull(){
-        return (sizeCurr == sizeTotal);
-    }
-    void enqueue(double x){
-        sizeCurr++;
-        int index = lastIndex%sizeTotal;
-        index = (index == 0)? index = sizeTotal-1 : index - 1;
-        rb[index] = x;
-        lastIndex++;
-    }
-
-    double dequeue(){
-        sizeCurr--;
-        int prevFirstIndex = firstIndex;
-        firstIndex++;
-        return rb[prevFirstIndex%sizeTotal];
-    }
-
-    double peek(){
-        return rb[firstIndex%sizeTotal];
-    }
-private:
-    int firstIndex;            // rb[first]  = first item in the buffer
-    int lastIndex;             // rb[last-1] = last  item in the buffer
-    int sizeTotal;             // current number of items in the buffer
-    int sizeCurr;             // current number of items in the buffer
-    double * rb;          // items in the buffer
-};
-
-class GuitarString {
-public:
-    GuitarString(double freq){
-        itemSize = (int)(44100/freq);
-        std::cout << "item size " << itemSize << std::endl;
-        ring = new RingBuffer(itemSize);
-        for(int i = 0; i < itemSize; i++){
-            ring->enqueue(0);
+    // Drives every track's amp `driveDb` into the clipper, oversampled by
+    // 2, 4 or 8; 0 leaves the amps bypassed. Half the drive is taken back
+    // off the output level so the tracks stay near their clean loudness.
+    // blockSize is the largest block the amps will see. Call before audio
+    // starts.
+    void ampDrive(float driveDb, int oversampling, int blockSize){
+        for(auto &track : tracks){
+            track.amp.prepare(oversampling, Track::busChannels, blockSize);
+            track.amp.drive(driveDb);
+            track.amp.level(-driveDb / 2);
         }
     }
-    void pluck(){
-        for(int i = 0; i < itemSize; i++){
-            ring->dequeue();
-        }
-        for(int i = 0; i < itemSize; i++){
-            double randVal = ((double) rand() / (RAND_MAX)) - 0.5;
-            ring->enqueue(randVal);
+
+    // Renders repeated notes once, ahead of the playhead, and replays them
+    // from up to `entries` takes of `seconds` each; 0 entries simulates
+    // every string. Notes then use a fixed excitation per frequency. Call
+    // before the score is built.
+    void noteCache(int entries, double seconds, double sampleRate){
+        cache.prepare(entries, (int)(seconds * sampleRate), sampleRate);
+        if(!cache.enabled()){
+            scheduler.onQueued(nullptr);
+            return;
         }
+        scheduler.onQueued([this](const NoteEvent &e){
+            cache.request(e.frequency, e.params ? (int)e.params->excitation : 0);
+        });
     }
-    void tic(){
-        double first = ring->dequeue();
-        double second = ring->peek();
-        ring->enqueue(((first + second)/2.0) * .996);
-    }
-    double sample(){
-        return ring->peek();
-    }
-private:
-    RingBuffer * ring;
-    int itemSize;
-};
 
-class GuitarVoice : public SynthVoice
-{
-public:
-    // Unit generators
-    int sampleRate;
-
-    gam::Pan<> mPan;
-    gam::Sine<> mOsc;
-    gam::Env<3> mAmpEnv;
-    std::vector<GuitarString> notesPlayed;
-    void init() override
-    {
-        mAmpEnv.curve(0); // make segments lines
-        mAmpEnv.levels(0, 1, 1, 0);
-        mAmpEnv.sustainPoint(2); // Make point 2 sustain until a release is issued
-
-        createInternalTriggerParameter("amplitude", 0.3, 0.0, 1.0);
-        createInternalTriggerParameter("frequency", 60, 20, 5000);
-        createInternalTriggerParameter("attackTime", 0.1, 0.01, 3.0);
-        createInternalTriggerParameter("releaseTime", 0.1, 0.1, 10.0);
-        createInternalTriggerParameter("pan", 0.0, -1.0, 1.0);
+    // Renders the tracks on `threads` threads (counting the audio thread):
+    // first the voice tasks of every track, then each track's body and amp.
+    // Call after bodyResonance(), before audio starts.
+    void renderThreads(int threads){
+        std::vector<std::pair<int, int>> voiceTasks;   // track, task
+        for(int t = 0; t < numTracks; t++){
+            for(int k = 0; k < tracks[t].voiceTasks(); k++){
+                voiceTasks.push_back(std::make_pair(t, k));
+            }
+        }
+        std::vector<ParallelRenderer::Stage> stages;
+        stages.push_back({(int)voiceTasks.size(), [this, voiceTasks](int i, int frames){
+            tracks[voiceTasks[i].first].renderVoices(voiceTasks[i].second, frames);
+        }});
+        stages.push_back({numTracks, [this](int t, int frames){
+            tracks[t].finish(frames);
+        }});
+        parallel.reset(new ParallelRenderer(stages, threads));
     }
 
-    // The audio processing function
-    void onProcess(AudioIOData &io) override
-    {
-        float f = getInternalParameterValue("frequency");
-        mOsc.freq(f);
+    void onCreate() override {
+        gam::sampleRate(audioIO().framesPerSecond());
+        buildScore(audioIO().framesPerSecond());
+        imguiInit();
+    }
 
-        mAmpEnv.lengths()[0] = getInternalParameterValue("attackTime");
-        mAmpEnv.lengths()[2] = getInternalParameterValue("releaseTime");
-        mPan.pos(getInternalParameterValue("pan"));
-        while (io())
-        {
-            float sumStrings = 0;
-            for(auto & i : notesPlayed){
-                sumStrings += i.sample();
-            }
-            float s1 = sumStrings * mAmpEnv() * getInternalParameterValue("amplitude") * 3;
-            for(auto & i : notesPlayed){
-                i.tic();
-            }
-            float s2;
-            mPan(s1, s1, s2);
-            io.out(0) += s1;
-            io.out(1) += s2;
+    // Streams the notes of a score file instead of the built-in score.
+    bool playScore(const std::string &path){
+        score.reset(new ScoreFile(path));
+        if(!score->valid()){
+            std::cerr << path << " is not a score file" << std::endl;
+            score.reset();
+            return false;
         }
-        if (mAmpEnv.done())
-            free();
+        return true;
     }
 
-    void onTriggerOn() override {
-        mAmpEnv.reset();
-        notesPlayed.emplace_back(GuitarString(getInternalParameterValue("frequency")));
-        std::cout << "new note created with f=" << getInternalParameterValue("frequency") << std::endl;
-        notesPlayed.at(notesPlayed.size()-1).pluck();
+    void onAnimate(double dt) override {
+        eventLog().drain(std::cout);
+        load.update(dt);
+        prefetchScore();
+        imguiBeginFrame();
+        scopeView.draw(scope);
+        imguiEndFrame();
     }
 
-    void onTriggerOff() override {
-        std::cout << " note released" << std::endl;
-        mAmpEnv.release();
+    void onDraw(Graphics &g) override {
+        g.clear();
+        imguiDraw();
     }
-    void update(double dt) override{
+
+    void onExit() override { imguiShutdown(); }
+
+    // Pages in the score records the scheduler reads next, so the audio
+    // thread does not fault on them.
+    void prefetchScore(){
+        if(score){
+            score->prefetch(scheduler.streamPosition(), prefetchNotes);
+        }
     }
-};
 
-struct MyApp : public App {
-    SynthGUIManager<GuitarVoice> sine;
-    SynthParams synthParams1;
-    SynthParams synthParams2;
-    SynthParams synthParams3;
-    SynthSequencer seq1;
-    SynthSequencer seq2;
-    SynthSequencer seq3;
-    std::vector<SynthParams> params;
-    std::vector<SynthVoice *> voices1;
-    std::vector<SynthVoice *> voices2;
-    std::vector<SynthVoice *> voices3;
+    // Renders the score without opening an audio device and writes it to
+    // path, reporting how much faster than realtime the render ran.
+    bool renderToFile(const std::string &path, double seconds,
+                      double sampleRate, int blockSize, int channels){
+        gam::sampleRate(sampleRate);
+        buildScore(sampleRate);
+
+        OfflineRenderer renderer(sampleRate, blockSize, channels);
+        OfflineRenderer::Stats stats;
+        double blockSeconds = blockSize / sampleRate;
+        LoadStats worst;
+        auto callback = [&](AudioIOData &io){
+            onSound(io);
+            eventLog().drain(std::cout);
+            prefetchScore();
+            if(load.update(blockSeconds)){
+                worst.max = std::max(worst.max, load.latest().max);
+                worst.p99 = std::max(worst.p99, load.latest().p99);
+            }
+        };
+        if(!renderer.render(callback, seconds, path, stats)){
+            std::cerr << "could not write " << path << std::endl;
+            return false;
+        }
+        std::cout << "rendered " << stats.audioSeconds << " s in "
+                  << stats.wallSeconds << " s (" << stats.realtimeFactor()
+                  << "x realtime) to " << path << std::endl;
+        std::cout << "worst callback p99 " << worst.p99 << "%, max " << worst.max
+                  << "% of the block period, " << loadMeter().read().xruns
+                  << " xruns" << std::endl;
+        if(cache.enabled()){
+            std::cout << "note cache: " << cache.hits() << " hits, " << cache.misses()
+                      << " misses, " << cache.rendered() << " rendered" << std::endl;
+        }
+#if GUITAR_RT_CHECK
+        uint64_t unsafe = RT_CHECK_VIOLATIONS();
+        std::cout << "rt-check: " << unsafe << " unsafe calls on the audio thread" << std::endl;
+        if(unsafe > 0){
+            return false;
+        }
+#endif
+        return true;
+    }
 
-    void onCreate() override {
-        gam::sampleRate(audioIO().framesPerSecond());
-        SynthParams params1{};
-        SynthParams params2{};
-        SynthParams params3{};
-
-        params1.attack = 10.0f;
-        params1.volume = 0.8f;
-        params1.tempo = 80.0f;
-        params.push_back(params1);
-        params2.attack = 10.0f;
-        params2.volume = 0.8f;
-        params2.tempo = 80.0f;
-        params.push_back(params2);
-        params3.attack = 10.0f;
-        params3.volume = 0.8f;
-        params3.tempo = 80.0f;
-        params.push_back(params3);
+    void buildScore(double sampleRate){
+        scheduler.sampleRate(sampleRate);
+        tracks[0].group.set(0.8f, 10.0f);
+        tracks[1].group.set(0.8f, 10.0f);
+        tracks[2].group.set(0.8f, 10.0f);
+        if(score){
+            scheduler.stream(*score);
+            return;
+        }
         for(float i = 0; i < 80; i+=4.0f){
-            voices1.push_back(createNotes(261.63f, i, 2.0f, &seq1, 0));
-            voices2.push_back(createNotes(293.66f, i, 2.0f, &seq2, 1));
-            voices3.push_back(createNotes(392.00f, i, 2.0f, &seq3, 2));
-            voices1.push_back(createNotes(293.66f, i+2.0f, 2.0f, &seq1, 0));
-            voices2.push_back(createNotes(493.88, i+2.5f, 1.5f, &seq2, 1));
-            voices3.push_back(createNotes(587.33, i+3.0f, 1.0f, &seq3, 2));
+            createNotes(261.63f, i, 2.0f, 0);
+            createNotes(293.66f, i, 2.0f, 1);
+            createNotes(392.00f, i, 2.0f, 2);
+            createNotes(293.66f, i+2.0f, 2.0f, 0);
+            createNotes(493.88, i+2.5f, 1.5f, 1);
+            createNotes(587.33, i+3.0f, 1.0f, 2);
         }
-        seq1.playSequence();
-        seq2.playSequence();
-        seq3.playSequence();
+    }
 
+    // Writes the built-in pattern, repeated for `seconds`, as a score file.
+    static bool writeScore(const std::string &path, double seconds){
+        std::vector<ScoreParams> params(2);
+        params[0] = {0.f, ExcitationBank::Noise, 0.1f, 0.f};
+        params[1] = {0.f, ExcitationBank::PickNearBridge, 0.1f, 0.f};
+        ScoreWriter writer(path, params);
+        for(double i = 0; i < seconds; i += 4.0){
+            writer.add(i,        2.0f, 261.63f/2, 0);
+            writer.add(i,        2.0f, 293.66f/2, 1);
+            writer.add(i,        2.0f, 392.00f/2, 2);
+            writer.add(i + 2.0,  2.0f, 293.66f/2, 0);
+            writer.add(i + 2.5,  1.5f, 493.88f/2, 1, 1);
+            writer.add(i + 3.0,  1.0f, 587.33f/2, 2, 1);
+        }
+        return writer.close();
     }
 
     void onSound(AudioIOData &io) override {
-        seq1.render(io);
-        seq2.render(io);
-        seq3.render(io);
+        flushDenormalsOnThisThread();
+        RT_CHECK_SCOPE();
+        LOAD_METER_CALLBACK(io);
+        // start and release notes at their exact frame in this block
+        scheduler.process(io.framesPerBuffer(), [this](const NoteEvent &e, int offset){
+            if(e.track >= numTracks){
+                return;
+            }
+            if(e.type == NoteEvent::On){
+                // notes without a parameter set get GuitarVoice::init()'s
+                // defaults, not whatever the voice played last
+                static const ScoreParams defaults = {0.f, 0.f, 0.1f, 0.f};
+                const ScoreParams *params = e.params ? e.params : &defaults;
+                NoteCache *c = cache.enabled() ? &cache : nullptr;
+                tracks[e.track].voices.noteOn(e.note, e.frequency, offset,
+                                              [params, c](GuitarVoice &voice){
+                    voice.cache(c);
+                    // through the handles, no name lookups on the audio thread
+                    voice.mPanPos.set(params->pan);
+                    voice.mExcitation.set(params->excitation);
+                    voice.mReleaseTime.set(params->releaseTime);
+                });
+            } else {
+                tracks[e.track].voices.noteOff(e.note, offset);
+            }
+        });
+
+        parallel->render(io.framesPerBuffer());
+        for(auto &track : tracks){
+            track.mix(io);
+        }
+        for(auto &track : tracks){
+            scopeStrings(track.voices, scope);
+        }
+        scope.publish();
     }
 
-    SynthVoice* createNotes(float freq, float start, float duration, SynthSequencer * seq, int instrumentNum){
-        SynthVoice *voice;
-        voice = sine.synth().getVoice<GuitarVoice>();
-        voice->setInternalParameterValue("amplitude", params[instrumentNum].volume);
-        voice->setInternalParameterValue("attackTime", params[instrumentNum].attack);
-        voice->setInternalParameterValue("frequency", freq/2);
-        seq->addVoiceFromNow(voice, start, duration);
-        return voice;
+    int createNotes(float freq, float start, float duration, int track){
+        return scheduler.addNote(start, duration, track, freq/2);
     }
 
+    // score records read ahead of the scheduler, about 24 KiB
+    static const size_t prefetchNotes = 1024;
+
     bool onKeyDown(Keyboard const &k) override {
         std::cout << k.key() << std::endl;
         int keyNum = k.key();
         switch (keyNum) {
             case 270: // Arrow Up
-                for(int i = 0; i < voices1.size(); i++){
-                    voices1.at(i)->setInternalParameterValue("amplitude",
-                                                             voices1.at(i)->getInternalParameterValue("amplitude") + .1);
-                }
+                tracks[0].group.adjustAmplitude(.1);
                 break;
             case 272: // Arrow Down
-                for(int i = 0; i < voices1.size(); i++) {
-
-                    voices1.at(i)->setInternalParameterValue("amplitude",
-                                                             voices1.at(i)->getInternalParameterValue("amplitude") -
-                                                             .1);
-                }
+                tracks[0].group.adjustAmplitude(-.1);
                 break;
             case 269: // Arrow Left
-                for(int i = 0; i < voices1.size(); i++){
-                    voices1.at(i)->setInternalParameterValue("attackTime",
-                                                             voices1.at(i)->getInternalParameterValue("attackTime") + .1);
-                }
+                tracks[0].group.adjustAttackTime(.1);
                 break;
             case 271: // Arrow Right
-                for(int i = 0; i < voices1.size(); i++) {
-
-                    voices1.at(i)->setInternalParameterValue("attackTime",
-                                                             voices1.at(i)->getInternalParameterValue("attackTime") -
-                                                             .1);
-                }
+                tracks[0].group.adjustAttackTime(-.1);
                 break;
 
             case 46: // '.' key
-                for(int i = 0; i < voices2.size(); i++) {
-                    voices2.at(i)->setInternalParameterValue("amplitude",
-                                                             voices2.at(i)->getInternalParameterValue("amplitude") +
-                                                             .1);
-                }
+                tracks[1].group.adjustAmplitude(.1);
                 break;
             case 47: // '/' key
-                for(int i = 0; i < voices2.size(); i++) {
-                    voices2.at(i)->setInternalParameterValue("amplitude",
-                                                             voices2.at(i)->getInternalParameterValue("amplitude") -
-                                                             .1);
-                }
+                tracks[1].group.adjustAmplitude(-.1);
                 break;
             case 59: // ';' key
-                for(int i = 0; i < voices3.size(); i++) {
-                    voices3.at(i)->setInternalParameterValue("amplitude",
-                                                             voices3.at(i)->getInternalParameterValue("amplitude") +
-                                                             .1);
-                }
+                tracks[2].group.adjustAmplitude(.1);
                 break;
             case 39: // '"' key
-                for(int i = 0; i < voices3.size(); i++) {
-                    voices3.at(i)->setInternalParameterValue("amplitude",
-                                                             voices3.at(i)->getInternalParameterValue("amplitude") -
-                                                             .1);
-                }
+                tracks[2].group.adjustAmplitude(-.1);
                 break;
             case 32: // Space Bar
                 break;
@@ -362,6 +366,23 @@ public:
     // The name provided determines the name of the directory
     // where the presets and sequences are stored
     SynthGUIManager<GuitarVoice> synthManager{"GuitarEnv"};
+    VoicePool voices;
+
+    // key presses, handed from the UI thread to the audio thread
+    struct KeyNote {
+        int note;
+        float frequency;
+    };
+    SpscRing<KeyNote, 256> keyNotes;
+    // the GUI voice's settings, published by the graphics thread each frame
+    TripleBuffer<GuitarVoice::Settings> guiSettings;
+    LoadReport load{0.25};
+    ScopeFeed scope;
+    ScopeView scopeView;
+    int polyphony = 16;
+    LatencyManager latency;
+    bool adaptiveLatency = true;   // false: keep the configured block size
+    double sinceReading = 0;
 
     // This function is called right after the window is created
     // It provides a graphics context to initialize ParameterGUI
@@ -376,6 +397,10 @@ public:
         gam::sampleRate(audioIO().framesPerSecond());
 
         imguiInit();
+        voices.allocate(polyphony);
+        voices.prepare(std::max((int)audioIO().framesPerBuffer(), latency.maxBlockSize()));
+        scope.prepare(1, audioIO().framesPerSecond());
+        publishSettings();
 
         // Play example sequence. Comment this line to start from scratch
         // synthManager.synthSequencer().playSequence("synth1.synthSequence");
@@ -385,7 +410,21 @@ public:
     // The audio callback function. Called when audio hardware requires data
     void onSound(AudioIOData &io) override
     {
-        synthManager.render(io); // Render audio
+        flushDenormalsOnThisThread();
+        RT_CHECK_SCOPE();
+        LOAD_METER_CALLBACK(io);
+        guiSettings.update();
+        const GuitarVoice::Settings &settings = guiSettings.front();
+        KeyNote k;
+        while (keyNotes.pop(k)) {
+            voices.noteOn(k.note, k.frequency, 0, [&settings](GuitarVoice &voice){
+                voice.settings(settings);
+            });
+        }
+        voices.render(io); // Render audio
+        scope.write(0, io.outBuffer(0), io.outBuffer(1), io.framesPerBuffer());
+        scopeStrings(voices, scope);
+        scope.publish();
     }
 
     void onAnimate(double dt) override {
@@ -393,8 +432,27 @@ public:
         imguiBeginFrame();
         // Draw a window that contains the synth control panel
         // synthManager.drawSynthControlPanel();
+        sinceReading += dt;
+        if (load.update(dt)) {
+            if (adaptiveLatency && latency.update(load.latest(), sinceReading)) {
+                blockSize(latency.blockSize());
+            }
+            sinceReading = 0;
+        }
+        drawLoadPanel(load.latest());
+        scopeView.draw(scope);
         imguiEndFrame();
         synthManager.synth().update(dt);
+        publishSettings();
+        eventLog().drain(std::cout);
+    }
+
+    // Hands the GUI voice's current settings to the audio thread, which
+    // applies them to the notes it starts.
+    void publishSettings()
+    {
+        guiSettings.back() = synthManager.voice()->settings();
+        guiSettings.publish();
     }
 
     // Whenever a key is pressed, this function is called
@@ -419,9 +477,10 @@ public:
             int midiNote = asciiToMIDI(k.key());
             if (midiNote > 0)
             {
-                synthManager.voice()->setInternalParameterValue(
-                        "frequency", ::pow(2.f, (midiNote - 69.f) / 12.f) * A4);
-                synthManager.triggerOn(midiNote);
+                KeyNote note;
+                note.note = midiNote;
+                note.frequency = ::pow(2.f, (midiNote - 69.f) / 12.f) * A4;
+                keyNotes.push(note);
             }
         }
         return true;
@@ -438,12 +497,205 @@ public:
         return true;
     }
 
+    void onDraw(Graphics &g) override
+    {
+        g.clear();
+        imguiDraw();
+    }
+
     void onExit() override { imguiShutdown(); }
+
+    // Times the worst case, every voice of the pool sounding, at each block
+    // size and returns the smallest one that keeps up. Call before audio
+    // starts.
+    int probeLatency(double sampleRate)
+    {
+        gam::sampleRate(sampleRate);
+        VoicePool pool;
+        pool.allocate(polyphony);
+        int frames = latency.probe([&](AudioIOData &io, bool start) {
+            if (start) {
+                for (int v = 0; v < polyphony; v++) {
+                    pool.noteOn(40 + v, 82.41f * ::pow(2.f, v / 12.f), 0);
+                }
+            }
+            pool.render(io);
+        }, sampleRate, 2);
+        loadMeter().read(); // drop the probe's voice timings
+        return frames;
+    }
+
+    // Reopens the device with a new block size. Called on the graphics
+    // thread; stopping the stream waits for the callback in flight. The
+    // restart does not count as an xrun.
+    void blockSize(int frames)
+    {
+        audioIO().stop();
+        audioIO().close();
+        audioIO().framesPerBuffer(frames);
+        loadMeter().restart(); // the gap is not a dropout
+        audioIO().open();
+        audioIO().start();
+        std::cout << "block size " << frames << " ("
+                  << 1000 * frames / audioIO().framesPerSecond() << " ms)" << std::endl;
+    }
+
+    void drawLoadPanel(const LoadStats &s)
+    {
+        ImGui::Begin("DSP load");
+        ImGui::Text("block %u frames, %.1f ms%s", audioIO().framesPerBuffer(),
+                    1000 * audioIO().framesPerBuffer() / audioIO().framesPerSecond(),
+                    adaptiveLatency ? " (adaptive)" : "");
+        ImGui::Text("callback  p50 %5.1f%%  p99 %5.1f%%  max %5.1f%%", s.p50, s.p99, s.max);
+        ImGui::ProgressBar((float)std::min(1.0, s.p99 / 100.0), ImVec2(-1, 0));
+        ImGui::Text("voice     p50 %5.0f us  p99 %5.0f us  max %5.0f us",
+                    s.voiceP50, s.voiceP99, s.voiceMax);
+        ImGui::Text("voices %d  strings %d  (pool %d, %u stolen, %u dropped)",
+                    s.voices, s.strings, voices.polyphony(), voices.stolen(), voices.dropped());
+        ImGui::Text("xruns %u", s.xruns);
+        ImGui::End();
+    }
 };
 
-int main() {
+int main(int argc, char *argv[]) {
+    eventLog(); // construct before the audio thread first logs to it
+    loadMeter();
+
+    // --render <file.wav|file.raw> [seconds]  render the score headless
+    // --threads <n>                           render tracks on n threads
+    // --polyphony <n>                         voices per track (default 16)
+    // --channels <n>                          output channels; more than two
+    //                                         are a ring of speakers
+    // --body <ir.wav|ir.raw|off>              body impulse response
+    // --amp <drive dB> [oversampling]         amp distortion, 2, 4 (default)
+    //                                         or 8 times oversampled
+    // --load-csv <file>                       stream DSP load readings
+    // --note-cache <entries> [seconds]        replay repeated notes from
+    //                                         prerendered takes (default 4 s)
+    // --score <file>                          play a binary score file
+    // --write-score <file> [seconds]          write the built-in pattern as a score
+    // --block <frames>                        audio block size; --play picks
+    //                                         it from the DSP load otherwise
+    // --play                                  play the guitar from the keyboard
+    std::string renderPath;
+    std::string bodyPath;
+    std::string loadCsvPath;
+    std::string scorePath;
+    std::string writeScorePath;
+    double seconds = 84.0;
+    double scoreSeconds = 80.0;
+    bool secondsGiven = false;
+    int threads = 1;
+    int polyphony = 16;
+    int channels = 2;
+    float driveDb = 0;
+    int oversampling = 0;
+    int block = 0;
+    int cacheEntries = 0;
+    double cacheSeconds = 4.0;
+    bool play = false;
+    for(int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        if(arg == "--render" && i + 1 < argc){
+            renderPath = argv[++i];
+            if(i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])){
+                seconds = atof(argv[++i]);
+                secondsGiven = true;
+            }
+        } else if(arg == "--threads" && i + 1 < argc){
+            threads = atoi(argv[++i]);
+        } else if(arg == "--polyphony" && i + 1 < argc){
+            polyphony = atoi(argv[++i]);
+        } else if(arg == "--channels" && i + 1 < argc){
+            channels = std::max(1, atoi(argv[++i]));
+        } else if(arg == "--amp" && i + 1 < argc){
+            driveDb = (float)atof(argv[++i]);
+            oversampling = 4;
+            if(i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])){
+                oversampling = atoi(argv[++i]);
+                if(oversampling != 2 && oversampling != 4 && oversampling != 8){
+                    std::cerr << "--amp oversampling must be 2, 4 or 8, not "
+                              << argv[i] << std::endl;
+                    return 1;
+                }
+            }
+        } else if(arg == "--body" && i + 1 < argc){
+            bodyPath = argv[++i];
+        } else if(arg == "--load-csv" && i + 1 < argc){
+            loadCsvPath = argv[++i];
+        } else if(arg == "--note-cache" && i + 1 < argc){
+            cacheEntries = atoi(argv[++i]);
+            if(i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])){
+                cacheSeconds = atof(argv[++i]);
+            }
+        } else if(arg == "--score" && i + 1 < argc){
+            scorePath = argv[++i];
+        } else if(arg == "--write-score" && i + 1 < argc){
+            writeScorePath = argv[++i];
+            if(i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])){
+                scoreSeconds = atof(argv[++i]);
+            }
+        } else if(arg == "--block" && i + 1 < argc){
+            block = std::max(1, atoi(argv[++i]));
+        } else if(arg == "--play"){
+            play = true;
+        }
+    }
+
+    if(!writeScorePath.empty()){
+        if(!MyApp::writeScore(writeScorePath, scoreSeconds)){
+            std::cerr << "could not write " << writeScorePath << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if(play){
+        GuyApp guy;
+        guy.polyphony = polyphony;
+        if(!loadCsvPath.empty() && !guy.load.csv(loadCsvPath)){
+            std::cerr << "could not write " << loadCsvPath << std::endl;
+            return 1;
+        }
+        if(block > 0){
+            guy.adaptiveLatency = false;
+        } else {
+            block = guy.probeLatency(44100.);
+            std::cout << "block size " << block << " (" << 1000 * block / 44100.
+                      << " ms)" << std::endl;
+        }
+        guy.configureAudio(44100., block, 2, 0);
+        guy.start();
+        return 0;
+    }
+
     MyApp app;
-    app.configureAudio(44100., 512, 2, 0);
+    if(!loadCsvPath.empty() && !app.load.csv(loadCsvPath)){
+        std::cerr << "could not write " << loadCsvPath << std::endl;
+        return 1;
+    }
+    app.noteCache(cacheEntries, cacheSeconds, 44100.);
+    if(!scorePath.empty()){
+        if(!app.playScore(scorePath)){
+            return 1;
+        }
+        if(!secondsGiven){
+            seconds = app.score->duration() + 2.0;
+        }
+    }
+    if(block == 0){
+        block = 512;
+    }
+    app.polyphony(polyphony, 44100., block);
+    if(!app.bodyResonance(bodyPath, 44100., block, channels)){
+        return 1;
+    }
+    app.ampDrive(driveDb, oversampling, block);
+    app.renderThreads(threads);
+    if(!renderPath.empty()){
+        return app.renderToFile(renderPath, seconds, 44100., block, channels) ? 0 : 1;
+    }
+
+    app.configureAudio(44100., block, channels, 0);
     app.start();
 }
-
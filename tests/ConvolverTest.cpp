@@ -0,0 +1,84 @@
+// Checks Convolver against direct time-domain convolution, for partition
+// sizes and call lengths that do and do not line up. Exits non-zero on the
+// first mismatch.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "Convolver.hpp"
+#include "Excitation.hpp"
+
+static std::vector<float> noise(int n, uint32_t seed){
+    XorShift32 random(seed);
+    std::vector<float> v(n);
+    for(auto &x : v){
+        x = random.nextFloat();
+    }
+    return v;
+}
+
+// y[n] = sum_k h[k] x[n - k], in double
+static std::vector<double> direct(const std::vector<float> &x, const std::vector<float> &h){
+    std::vector<double> y(x.size(), 0.0);
+    for(size_t n = 0; n < x.size(); n++){
+        for(size_t k = 0; k < h.size() && k <= n; k++){
+            y[n] += (double)h[k] * x[n - k];
+        }
+    }
+    return y;
+}
+
+// Runs x through a Convolver in calls of the given lengths, cycling, and
+// compares with the direct result delayed by the mode's latency.
+static bool check(int irLength, int partition, Convolver::Latency latency,
+                  const std::vector<int> &calls){
+    std::vector<float> h = noise(irLength, 7);
+    std::vector<float> x = noise(4000, 11);
+    std::vector<double> want = direct(x, h);
+
+    Convolver conv;
+    conv.prepare(std::make_shared<const PartitionedIR>(h, partition), latency);
+    std::vector<float> y = x;
+    size_t pos = 0;
+    for(int c = 0; pos < y.size(); c++){
+        int n = std::min<int>(calls[c % calls.size()], (int)(y.size() - pos));
+        if(latency == Convolver::ZeroLatency){
+            n -= n % partition;
+            if(n == 0){
+                break;
+            }
+        }
+        conv.process(y.data() + pos, n);
+        pos += n;
+    }
+
+    int delay = latency == Convolver::ZeroLatency ? 0 : partition;
+    double worst = 0;
+    for(size_t i = 0; i < pos; i++){
+        double expected = i >= (size_t)delay ? want[i - delay] : 0.0;
+        worst = std::max(worst, std::abs(y[i] - expected));
+    }
+    bool ok = worst < 1e-4;
+    std::printf("%s ir %d, partition %d, %s, calls of %d..: max error %g\n",
+                ok ? "ok  " : "FAIL", irLength, partition,
+                latency == Convolver::ZeroLatency ? "zero latency" : "one partition",
+                calls[0], worst);
+    return ok;
+}
+
+int main(){
+    bool ok = true;
+    ok &= check(37, 4, Convolver::OnePartition, {37});
+    ok &= check(300, 4, Convolver::OnePartition, {37});
+    ok &= check(300, 64, Convolver::OnePartition, {100});
+    ok &= check(300, 64, Convolver::OnePartition, {1});
+    ok &= check(1000, 64, Convolver::OnePartition, {63, 64, 65, 200, 7});
+    ok &= check(300, 64, Convolver::OnePartition, {64});
+    ok &= check(300, 4, Convolver::ZeroLatency, {4});
+    ok &= check(300, 64, Convolver::ZeroLatency, {64});
+    ok &= check(1000, 64, Convolver::ZeroLatency, {192, 64, 128});
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+// Checks that every kernel variant this CPU can run gives the same bits as
+// the generic one, on the same inputs. Exits non-zero on the first
+// mismatch.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "DspKernels.hpp"
+#include "Excitation.hpp"
+
+extern const DspKernels dspKernelsGeneric;
+#if GUITAR_DSP_X86_KERNELS
+extern const DspKernels dspKernelsAvx2;
+extern const DspKernels dspKernelsAvx512;
+#endif
+
+static std::vector<float> noise(int n, uint32_t seed){
+    XorShift32 random(seed);
+    std::vector<float> v(n);
+    for(auto &x : v){
+        x = random.nextFloat();
+    }
+    return v;
+}
+
+static bool same(const std::vector<float> &a, const std::vector<float> &b){
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+// Runs each kernel of k on fixed inputs and appends every output, line
+// state included, to out.
+static std::vector<float> run(const DspKernels &k){
+    std::vector<float> out;
+
+    // a short and a long string, so runs wrap the line and the loop is
+    // both shorter and longer than a vector
+    for(int length : {5, 301}){
+        std::vector<float> line = noise(1024, length);
+        std::vector<float> y(1000, 0.f);
+        k.karplusStrongBlock(line.data(), 1023, 1000, length, 0.498f, y.data(), (int)y.size());
+        out.insert(out.end(), y.begin(), y.end());
+        out.insert(out.end(), line.begin(), line.end());
+    }
+
+    const int n = 257;
+    std::vector<float> accRe = noise(n, 1), accIm = noise(n, 2);
+    std::vector<float> xRe = noise(n, 3), xIm = noise(n, 4);
+    std::vector<float> hRe = noise(n, 5), hIm = noise(n, 6);
+    k.complexMultiplyAdd(accRe.data(), accIm.data(), xRe.data(), xIm.data(),
+                         hRe.data(), hIm.data(), n);
+    out.insert(out.end(), accRe.begin(), accRe.end());
+    out.insert(out.end(), accIm.begin(), accIm.end());
+
+    std::vector<float> mixed = noise(n, 7);
+    k.mixGain(mixed.data(), xRe.data(), 0.7f, -0.001f, n);
+    out.insert(out.end(), mixed.begin(), mixed.end());
+
+    const int taps = 48;
+    std::vector<float> fir(n, 0.f);
+    std::vector<float> in = noise(n + taps - 1, 8);
+    std::vector<float> h = noise(taps, 9);
+    k.firBlock(fir.data(), in.data(), h.data(), taps, n);
+    out.insert(out.end(), fir.begin(), fir.end());
+
+    std::vector<float> table = noise(1026, 10);   // x at the top reads table[size + 1]
+    std::vector<float> buf = noise(n, 11);
+    k.waveshape(buf.data(), n, table.data(), 1024, 400.f, 512.f, 2.f, 0.01f, 0.8f);
+    out.insert(out.end(), buf.begin(), buf.end());
+    return out;
+}
+
+int main(){
+    std::vector<float> want = run(dspKernelsGeneric);
+    std::printf("ok   %s: reference\n", dspKernelsGeneric.isa);
+    bool ok = true;
+#if GUITAR_DSP_X86_KERNELS && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    const DspKernels *variants[] = {&dspKernelsAvx2, &dspKernelsAvx512};
+    const bool supported[] = {
+        (bool)__builtin_cpu_supports("avx2"),
+        (bool)__builtin_cpu_supports("avx512f"),
+    };
+    for(int i = 0; i < 2; i++){
+        if(!supported[i]){
+            std::printf("skip %s: not supported by this CPU\n", variants[i]->isa);
+            continue;
+        }
+        bool match = same(run(*variants[i]), want);
+        std::printf("%s %s: %s the generic kernels\n", match ? "ok  " : "FAIL",
+                    variants[i]->isa, match ? "bit-identical to" : "differs from");
+        ok &= match;
+    }
+#endif
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+// Checks that EventScheduler hands out every event on its exact sample,
+// whatever the block size, for added and streamed notes. Exits non-zero on
+// the first mismatch.
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "EventScheduler.hpp"
+
+static const double kSampleRate = 44100.;
+
+struct Note {
+    double start;
+    float duration;
+};
+
+static const Note kNotes[] = {
+    {0.0, 0.5f}, {0.0, 0.25f}, {0.01, 1.0f}, {0.3333, 0.1f},
+    {0.5, 0.5f}, {1.2345, 0.01f}, {2.0, 0.75f}, {2.0001, 0.3f},
+};
+static const int kNumNotes = sizeof(kNotes) / sizeof(kNotes[0]);
+
+// Dispatches every event in blocks of `block` frames and compares the
+// frame it lands on, block start plus offset, with its note's times.
+static bool check(EventScheduler &scheduler, int block, const char *what){
+    std::vector<long> on(kNumNotes, -1), off(kNumNotes, -1);
+    long blockStart = 0;
+    bool ordered = true;
+    long last = 0;
+    for(int b = 0; b < (int)(3.0 * kSampleRate / block) + 1; b++){
+        scheduler.process(block, [&](const NoteEvent &e, int offset){
+            long frame = blockStart + offset;
+            ordered &= offset >= 0 && offset < block && frame >= last;
+            last = frame;
+            (e.type == NoteEvent::On ? on : off)[e.note % kNumNotes] = frame;
+        });
+        blockStart += block;
+    }
+    bool ok = ordered;
+    for(int i = 0; i < kNumNotes; i++){
+        ok &= on[i] == std::llround(kNotes[i].start * kSampleRate)
+              && off[i] == std::llround((kNotes[i].start + kNotes[i].duration) * kSampleRate);
+    }
+    std::printf("%s %s, blocks of %d\n", ok ? "ok  " : "FAIL", what, block);
+    return ok;
+}
+
+int main(){
+    {
+        ScoreWriter writer("event_scheduler_test.score", {ScoreParams{0.f, 0.f, 0.1f, 0.f}});
+        for(const Note &n : kNotes){
+            writer.add(n.start, n.duration, 110.f, 0);
+        }
+        if(!writer.close()){
+            std::printf("FAIL could not write the test score\n");
+            return 1;
+        }
+    }
+    ScoreFile score("event_scheduler_test.score");
+
+    bool ok = true;
+    for(int block : {1, 64, 100, 512, 4096}){
+        EventScheduler added;
+        added.sampleRate(kSampleRate);
+        for(const Note &n : kNotes){
+            added.addNote(n.start, n.duration, 0, 110.f);
+        }
+        ok &= check(added, block, "added notes");
+
+        EventScheduler streamed;
+        streamed.sampleRate(kSampleRate);
+        streamed.stream(score, 0.1);
+        ok &= check(streamed, block, "streamed notes");
+    }
+    std::remove("event_scheduler_test.score");
+    return ok ? 0 : 1;
+}
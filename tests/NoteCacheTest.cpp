@@ -0,0 +1,76 @@
+// Checks that a string played from a NoteCache take gives the same bits as
+// the same string simulated live, through the end of the take, the handoff
+// to simulation and retirement. Exits non-zero on the first mismatch.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "Denormals.hpp"
+#include "Excitation.hpp"
+#include "GuitarStringBank.hpp"
+#include "NoteCache.hpp"
+
+static const double kSampleRate = 44100.;
+
+// Waits up to a few seconds for the render thread to finish the take.
+static bool waitForTake(NoteCache &cache, float frequency, int excitation, StringTake &take){
+    for(int i = 0; i < 2000; i++){
+        if(cache.take(frequency, excitation, take)){
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    return false;
+}
+
+// Plays the take in one bank and simulates the string in another, in
+// blocks of `block` frames, until both have retired it.
+static bool check(NoteCache &cache, float frequency, ExcitationBank::Type type, int block){
+    StringTake take;
+    cache.request(frequency, type);
+    if(!waitForTake(cache, frequency, type, take)){
+        std::printf("FAIL %g Hz, excitation %d: take never rendered\n", frequency, (int)type);
+        return false;
+    }
+    int length = take.length;
+
+    GuitarStringBank cached(1, kSampleRate);
+    GuitarStringBank live(1, kSampleRate);
+    cached.pluck(frequency, take);
+    live.pluck(frequency, ExcitationBank::shared().get(type, NoteCache::seed(frequency)));
+
+    std::vector<float> a(block), b(block);
+    long frames = 0;
+    bool ok = true;
+    while(ok && (cached.activeStrings() > 0 || live.activeStrings() > 0)){
+        std::fill(a.begin(), a.end(), 0.f);
+        std::fill(b.begin(), b.end(), 0.f);
+        cached.process(a.data(), block);
+        live.process(b.data(), block);
+        ok = std::memcmp(a.data(), b.data(), block * sizeof(float)) == 0
+             && cached.activeStrings() == live.activeStrings();
+        frames += block;
+    }
+    std::printf("%s %g Hz, excitation %d, blocks of %d: take of %d frames, %s after %ld\n",
+                ok ? "ok  " : "FAIL", frequency, (int)type, block, length,
+                ok ? "both retired" : "differs", frames);
+    return ok;
+}
+
+int main(){
+    flushDenormalsOnThisThread();   // as the audio and render threads do
+    NoteCache cache;
+    // takes shorter than the strings ring, so playback hands off to
+    // simulation part way through
+    cache.prepare(4, (int)(0.5 * kSampleRate), kSampleRate);
+
+    bool ok = true;
+    ok &= check(cache, 110.f, ExcitationBank::Noise, 512);
+    ok &= check(cache, 146.83f, ExcitationBank::SoftNoise, 100);
+    ok &= check(cache, 329.63f, ExcitationBank::PickNearBridge, 64);
+    ok &= check(cache, 82.41f, ExcitationBank::PickCenter, 333);
+    return ok ? 0 : 1;
+}
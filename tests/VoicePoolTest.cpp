@@ -0,0 +1,45 @@
+// Checks VoicePool's stealing and dropping with a pool of two voices plus
+// one headroom voice. Exits non-zero on the first failed check.
+
+#include <cstdio>
+
+#include "Gamma/Domain.h"
+
+#include "VoicePool.hpp"
+
+static int fading(const VoicePool &pool){
+    int n = 0;
+    pool.forEachSounding([&n](const GuitarVoice &voice){
+        n += voice.fading() ? 1 : 0;
+    });
+    return n;
+}
+
+static bool expect(const VoicePool &pool, int sounding, int fades,
+                   unsigned stolen, unsigned dropped, const char *what){
+    bool ok = pool.sounding() == sounding && fading(pool) == fades
+              && pool.stolen() == stolen && pool.dropped() == dropped;
+    std::printf("%s %s: %d sounding, %d fading, %u stolen, %u dropped\n",
+                ok ? "ok  " : "FAIL", what, pool.sounding(), fading(pool),
+                pool.stolen(), pool.dropped());
+    return ok;
+}
+
+int main(){
+    gam::sampleRate(44100);
+    VoicePool pool;
+    pool.allocate(2, nullptr, 1);
+
+    bool ok = true;
+    pool.noteOn(1, 110.f, 0);
+    pool.noteOn(2, 220.f, 0);
+    ok &= expect(pool, 2, 0, 0, 0, "under the cap");
+    pool.noteOn(3, 330.f, 0);
+    ok &= expect(pool, 3, 1, 1, 0, "steal onto the headroom voice");
+    // every voice is taken: the note is dropped and nothing more is cut
+    pool.noteOn(4, 440.f, 0);
+    ok &= expect(pool, 3, 1, 1, 1, "full pool");
+    pool.noteOn(5, 550.f, 0);
+    ok &= expect(pool, 3, 1, 1, 2, "full pool again");
+    return ok ? 0 : 1;
+}